@@ -2,15 +2,31 @@
 #define ASSIGNMENTS_DG_GRAPH_H_
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <iostream>
 #include <iterator>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <queue>
 #include <set>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -18,6 +34,8 @@ namespace gdwg {
 
 template <typename T>
 struct CompareByValue {
+  using is_transparent = void;
+
   bool operator()(const std::shared_ptr<T>& lhs, const std::shared_ptr<T>& rhs) const {
     return lhs->GetValue() < rhs->GetValue();
   }
@@ -27,36 +45,199 @@ struct CompareByValue {
     std::shared_ptr<T> rhs_sp = rhs.lock();
     return (lhs_sp && rhs_sp) && lhs_sp->GetValue() < rhs_sp->GetValue();
   }
+
+  template <typename V>
+  bool operator()(const std::shared_ptr<T>& lhs, const V& rhs) const {
+    return lhs->GetValue() < rhs;
+  }
+
+  template <typename V>
+  bool operator()(const V& lhs, const std::shared_ptr<T>& rhs) const {
+    return lhs < rhs->GetValue();
+  }
+
+  template <typename V>
+  bool operator()(const std::weak_ptr<T>& lhs, const V& rhs) const {
+    std::shared_ptr<T> lhs_sp = lhs.lock();
+    return lhs_sp && lhs_sp->GetValue() < rhs;
+  }
+
+  template <typename V>
+  bool operator()(const V& lhs, const std::weak_ptr<T>& rhs) const {
+    std::shared_ptr<T> rhs_sp = rhs.lock();
+    return rhs_sp && lhs < rhs_sp->GetValue();
+  }
 };
 
+// writes and reads values in the graph's binary delta format
+// specialise for node or weight types that are neither trivially copyable nor std::string
+// to journal them, graphs of other types work as usual but cannot enable the journal
+template <typename T, typename Enable = void>
+struct Serializer;
+
+template <typename T>
+struct Serializer<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+  static void Write(std::string& out, const T& val) {
+    out.append(reinterpret_cast<const char*>(&val), sizeof(T));
+  }
+
+  static T Read(const std::string& in, std::size_t& pos) {
+    if (in.size() - pos < sizeof(T)) {
+      throw std::runtime_error("Cannot read past the end of a delta");
+    }
+    T val;
+    std::memcpy(&val, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return val;
+  }
+};
+
+template <>
+struct Serializer<std::string> {
+  static void Write(std::string& out, const std::string& val) {
+    Serializer<std::uint64_t>::Write(out, val.size());
+    out.append(val);
+  }
+
+  static std::string Read(const std::string& in, std::size_t& pos) {
+    auto size = Serializer<std::uint64_t>::Read(in, pos);
+    if (in.size() - pos < size) {
+      throw std::runtime_error("Cannot read past the end of a delta");
+    }
+    std::string val = in.substr(pos, size);
+    pos += size;
+    return val;
+  }
+};
+
+// whether Serializer is specialised for T, so a graph of it can keep a journal
+template <typename T, typename Enable = void>
+struct IsSerializable : std::false_type {};
+
+template <typename T>
+struct IsSerializable<T, std::void_t<decltype(sizeof(Serializer<T>))>> : std::true_type {};
+
 template <typename P>
 struct Comparator {
   bool operator()(const P& lhs, const P& rhs) const { return lhs < rhs; }
 };
 
+// sorted vector with the parts of the std::set interface the graph uses
+// the weights of an edge sit contiguously instead of in one allocation each
+template <typename T, typename Compare = Comparator<T>>
+class FlatSet {
+ public:
+  using value_type = T;
+  using const_iterator = typename std::vector<T>::const_iterator;
+  using iterator = const_iterator;
+  using size_type = std::size_t;
+
+  FlatSet() = default;
+  FlatSet(std::initializer_list<T> list) { insert(list.begin(), list.end()); }
+
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator end() const { return values_.end(); }
+  const_iterator cbegin() const { return values_.cbegin(); }
+  const_iterator cend() const { return values_.cend(); }
+  bool empty() const { return values_.empty(); }
+  size_type size() const { return values_.size(); }
+  const T* data() const { return values_.data(); }
+
+  std::pair<iterator, bool> emplace(const T& value) { return insert(value); }
+
+  std::pair<iterator, bool> insert(const T& value) {
+    auto it = std::lower_bound(values_.cbegin(), values_.cend(), value, Compare{});
+    if (it != values_.cend() && !Compare{}(value, *it)) {
+      return {it, false};
+    }
+    return {values_.insert(it, value), true};
+  }
+
+  template <typename It>
+  void insert(It first, It last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  const_iterator find(const T& value) const {
+    auto it = std::lower_bound(values_.cbegin(), values_.cend(), value, Compare{});
+    return (it != values_.cend() && !Compare{}(value, *it)) ? it : values_.cend();
+  }
+
+  const_iterator upper_bound(const T& value) const {
+    return std::upper_bound(values_.cbegin(), values_.cend(), value, Compare{});
+  }
+
+  iterator erase(const_iterator pos) { return values_.erase(pos); }
+
+  friend bool operator==(const FlatSet& lhs, const FlatSet& rhs) {
+    return lhs.values_ == rhs.values_;
+  }
+
+  friend bool operator!=(const FlatSet& lhs, const FlatSet& rhs) { return !(lhs == rhs); }
+
+ private:
+  std::vector<T> values_;
+};
+
+// small trivially copyable weights, such as integers and floating point numbers, are kept
+// in a FlatSet, anything else in a std::set; like a std::vector, a FlatSet invalidates
+// iterators into an edge's weights when a weight is inserted on or erased from that edge
+template <typename E>
+using WeightSetFor = std::conditional_t<std::is_trivially_copyable<E>::value &&
+                                            sizeof(E) <= 2 * sizeof(void*),
+                                        FlatSet<E>,
+                                        std::set<E, Comparator<E>>>;
+
+template <typename T, typename Enable = void>
+struct IsHashable : std::false_type {};
+
+template <typename T>
+struct IsHashable<T, std::void_t<decltype(std::hash<T>{}(std::declval<const T&>()))>>
+  : std::true_type {};
+
+template <typename N, typename E>
+class SharedImage;
+
 template <typename N, typename E>
 class Graph {
  public:
+  using WeightSet = WeightSetFor<E>;
+
   class Node {
    public:
     explicit Node(N);
 
-    N GetValue() const;
+    const N& GetValue() const;
     void SetValue(const N&);
-    bool AddEdgeTo(const std::shared_ptr<Node>&, const E&);
-    bool IsEdge(const N&) const;
-    bool DeleteEdge(const N&, const E&);
+    void SetValue(N&&);
+    bool AddEdgeTo(const std::shared_ptr<Node>&, const E&, bool exhaustive = true);
+    bool AddEdgeTo(const std::shared_ptr<Node>&, E&&, bool exhaustive = true);
+    bool IsEdge(const N&, bool exhaustive = true) const;
+    bool DeleteEdge(const N&, const E&, bool exhaustive = true);
     std::vector<N> GetEdges() const;
-    std::vector<E> GetWeights(const N&) const;
-    std::vector<std::pair<std::weak_ptr<Node>, std::set<E, Comparator<E>>>> EdgesWeights() const;
+    std::vector<E> GetWeights(const N&, bool exhaustive = true) const;
+    std::vector<std::pair<std::weak_ptr<Node>, WeightSet>> EdgesWeights() const;
 
    private:
     friend class Graph;
 
+    template <typename M>
+    static auto FindEdgeIn(M&, const N&, bool) -> decltype(std::declval<M&>().begin());
+    template <typename W>
+    bool AddWeight(const std::shared_ptr<Node>&, W&&, bool);
+
     N value_;
-    std::map<std::weak_ptr<Node>, std::set<E, Comparator<E>>, CompareByValue<Node>> edges_out_;
+    std::map<std::weak_ptr<Node>, WeightSet, CompareByValue<Node>> edges_out_;
+    // number of weights on edges out of and into this node
+    std::size_t out_degree_ = 0;
+    std::size_t in_degree_ = 0;
   };
 
+  // inserting a weight on an edge that already has one invalidates iterators to that edge's
+  // weights when they are kept in a FlatSet; with a std::set only erasing does, as with the
+  // iterators of a std::set
   class const_iterator {
    public:
     using iterator_category = std::bidirectional_iterator_tag;
@@ -85,21 +266,21 @@ class Graph {
    private:
     friend class Graph;
 
-    void Next();
-    void Prev(bool flag);
+    void SeekForward();
+    void SeekBackward();
 
     typename std::set<std::shared_ptr<Node>, CompareByValue<Node>>::iterator node_from_itr_;
     const typename std::set<std::shared_ptr<Node>, CompareByValue<Node>>::iterator node_from_start_;
     const typename std::set<std::shared_ptr<Node>, CompareByValue<Node>>::iterator node_from_end_;
-    typename std::map<std::weak_ptr<Node>, std::set<E, Comparator<E>>, CompareByValue<Node>>::
+    typename std::map<std::weak_ptr<Node>, WeightSet, CompareByValue<Node>>::
         iterator node_to_itr_;
-    typename std::map<std::weak_ptr<Node>, std::set<E, Comparator<E>>, CompareByValue<Node>>::
+    typename std::map<std::weak_ptr<Node>, WeightSet, CompareByValue<Node>>::
         iterator node_to_start_;
-    typename std::map<std::weak_ptr<Node>, std::set<E, Comparator<E>>, CompareByValue<Node>>::
+    typename std::map<std::weak_ptr<Node>, WeightSet, CompareByValue<Node>>::
         iterator node_to_end_;
-    typename std::set<E, Comparator<E>>::iterator weight_itr_;
-    typename std::set<E, Comparator<E>>::iterator weight_start_;
-    typename std::set<E, Comparator<E>>::iterator weight_end_;
+    typename WeightSet::const_iterator weight_itr_;
+    typename WeightSet::const_iterator weight_start_;
+    typename WeightSet::const_iterator weight_end_;
 
     const_iterator(const decltype(node_from_itr_)& from,
                    const decltype(node_from_start_)& from_start,
@@ -120,6 +301,9 @@ class Graph {
   Graph<N, E>(typename std::vector<std::tuple<N, N, E>>::const_iterator,
               typename std::vector<std::tuple<N, N, E>>::const_iterator);
   Graph<N, E>(std::initializer_list<N>);
+  // consume their input, moving the values out instead of copying them
+  explicit Graph<N, E>(std::vector<N>&&);
+  explicit Graph<N, E>(std::vector<std::tuple<N, N, E>>&&);
   Graph<N, E>(const gdwg::Graph<N, E>&);
   Graph<N, E>(gdwg::Graph<N, E>&&) noexcept;
   ~Graph<N, E>() noexcept = default;
@@ -128,20 +312,193 @@ class Graph {
   Graph<N, E>& operator=(gdwg::Graph<N, E>&&) noexcept;
 
   bool InsertNode(const N&);
+  bool InsertNode(N&&);
   bool InsertEdge(const N&, const N&, const E&);
+  bool InsertEdge(const N&, const N&, E&&);
+  // construct a node value or weight from args and move it in, so N and E must be movable
+  template <typename... Args>
+  bool EmplaceNode(Args&&...);
+  template <typename... Args>
+  bool EmplaceEdge(const N&, const N&, Args&&...);
   bool DeleteNode(const N&);
   bool Replace(const N&, const N&);
+  bool Replace(const N&, N&&);
   void MergeReplace(const N&, const N&);
   void Clear();
   bool IsNode(const N&) const;
   bool IsConnected(const N&, const N&) const;
   std::vector<N> GetNodes() const;
+  std::size_t NodeCount() const;
+  std::size_t EdgeCount() const;
+  std::size_t OutDegree(const N&) const;
+  std::size_t InDegree(const N&) const;
   std::vector<N> GetConnected(const N&) const;
   std::vector<E> GetWeights(const N&, const N&) const;
   bool erase(const N&, const N&, const E&);
 
+  // weights of query i are weights[offsets[i]] up to weights[offsets[i + 1]]
+  struct WeightsBatch {
+    std::vector<std::size_t> offsets;
+    std::vector<E> weights;
+  };
+
+  std::vector<bool> IsConnectedBatch(const std::vector<std::pair<N, N>>&,
+                                     unsigned int num_threads = 1) const;
+  WeightsBatch GetWeightsBatch(const std::vector<std::pair<N, N>>&,
+                               unsigned int num_threads = 1) const;
+
   const_iterator erase(const_iterator);
   const_iterator find(const N&, const N&, const E&) const;
+  const_iterator LowerBound(const N&) const;
+  const_iterator LowerBound(const N&, const N&) const;
+
+  template <typename F>
+  void ForEachEdge(F) const;
+  // every thread calls the caller's fn itself rather than a copy, so state it keeps is
+  // seen by the caller afterwards, and fn must be safe to call concurrently
+  template <typename F>
+  void ParallelForEachEdge(F&&, unsigned int num_threads = 0) const;
+  // folds each thread's edges into T{} with fn(acc, src, dest, weight), then combines the
+  // partials into init with acc = combine(acc, partial); T{} must be an identity of combine
+  template <typename T, typename F, typename R>
+  T ParallelReduceEdges(T, F, R, unsigned int num_threads = 0) const;
+
+  std::vector<N> TopologicalOrder() const;
+  bool IsAcyclic() const;
+  std::vector<N> FindCycle() const;
+
+  std::vector<std::vector<N>> StronglyConnectedComponents() const;
+  std::vector<std::vector<N>>
+  ParallelStronglyConnectedComponents(unsigned int num_threads = 0) const;
+  Graph<N, E> Condensation() const;
+
+  struct PageRankOptions {
+    double damping = 0.85;
+    // iteration stops once the ranks change by less than this in total
+    double tolerance = 1e-6;
+    std::size_t max_iterations = 100;
+    // split a node's rank by the weight of each edge rather than evenly between neighbours
+    bool weighted = false;
+    unsigned int num_threads = 0;
+  };
+
+  struct PageRankResult {
+    // in node order, summing to one
+    std::vector<std::pair<N, double>> ranks;
+    // total change in rank and wall time of each iteration
+    std::vector<double> residuals;
+    std::vector<double> iteration_ms;
+    bool converged = false;
+  };
+
+  PageRankResult PageRank() const;
+  PageRankResult PageRank(const PageRankOptions&) const;
+
+  struct Path {
+    std::vector<N> nodes;
+    E cost;
+  };
+
+  // up to k loopless paths from src to dst in ascending cost, each hop costing the smallest
+  // weight between its nodes; results are cached until a mutation could change them
+  std::vector<Path> ShortestPaths(const N&, const N&, std::size_t) const;
+  void SetPathCacheCapacity(std::size_t);
+  std::size_t PathCacheSize() const;
+
+  // new graphs holding a subset of the nodes and the edges between them, built in one pass
+  Graph<N, E> InducedSubgraph(const std::vector<N>&) const;
+  // the nodes reachable from center in at most hops edges
+  Graph<N, E> EgoGraph(const N&, std::size_t) const;
+  // the nodes for which keep_node(n) holds, and the edges for which keep_edge(src, dst, w) holds
+  template <typename P>
+  Graph<N, E> Subgraph(P) const;
+  template <typename P, typename Q>
+  Graph<N, E> Subgraph(P, Q) const;
+
+  // read only view of the nodes and edges kept by the same predicates, evaluated on access
+  // without copying the graph, which must outlive the view
+  template <typename P, typename Q>
+  class SubgraphView {
+   public:
+    class const_iterator {
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = std::tuple<N, N, E>;
+      using reference = typename Graph::const_iterator::reference;
+      using pointer = void;
+      using difference_type = std::ptrdiff_t;
+
+      reference operator*() const { return *itr_; }
+
+      const_iterator& operator++() {
+        ++itr_;
+        SkipFiltered();
+        return *this;
+      }
+
+      const_iterator operator++(int) {
+        auto tmp{*this};
+        ++(*this);
+        return tmp;
+      }
+
+      friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) {
+        return lhs.itr_ == rhs.itr_;
+      }
+
+      friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) {
+        return !(lhs == rhs);
+      }
+
+     private:
+      friend class SubgraphView;
+
+      const_iterator(const SubgraphView* view, typename Graph::const_iterator itr)
+        : view_{view}, itr_{itr} {
+        SkipFiltered();
+      }
+
+      void SkipFiltered() {
+        while (itr_ != view_->graph_->end()) {
+          const auto& [src, dst, w] = *itr_;
+          if (view_->Keeps(src, dst, w)) {
+            return;
+          }
+          ++itr_;
+        }
+      }
+
+      const SubgraphView* view_;
+      typename Graph::const_iterator itr_;
+    };
+
+    SubgraphView(const Graph* graph, P keep_node, Q keep_edge)
+      : graph_{graph}, keep_node_{std::move(keep_node)}, keep_edge_{std::move(keep_edge)} {}
+
+    bool IsNode(const N&) const;
+    bool IsConnected(const N&, const N&) const;
+    std::vector<N> GetNodes() const;
+    std::vector<N> GetConnected(const N&) const;
+    std::vector<E> GetWeights(const N&, const N&) const;
+    Graph<N, E> ToGraph() const { return graph_->Subgraph(keep_node_, keep_edge_); }
+
+    const_iterator begin() const { return const_iterator{this, graph_->begin()}; }
+    const_iterator end() const { return const_iterator{this, graph_->end()}; }
+
+   private:
+    bool Keeps(const N& src, const N& dst, const E& w) const {
+      return keep_node_(src) && keep_node_(dst) && keep_edge_(src, dst, w);
+    }
+
+    const Graph* graph_;
+    P keep_node_;
+    Q keep_edge_;
+  };
+
+  template <typename P>
+  auto Filter(P) const;
+  template <typename P, typename Q>
+  SubgraphView<P, Q> Filter(P, Q) const;
 
   const_iterator cbegin() const;
   const_iterator cend() const;
@@ -155,16 +512,203 @@ class Graph {
   const_reverse_iterator rbegin() const;
   const_reverse_iterator rend() const;
 
-  friend bool operator==(const gdwg::Graph<N, E>& g1, const gdwg::Graph<N, E>& g2) {
-    auto it1 = g1.begin(), it2 = g2.begin();
-    for (; it1 != g1.end() && it2 != g2.end(); ++it1, ++it2) {
-      auto [n1_1, n1_2, c1] = *it1;
-      auto [n2_1, n2_2, c2] = *it2;
-      if (n1_1 != n2_1 && n1_2 != n2_2 && c1 != c2) {
-        return false;
+  // read only range over the graph's own containers, invalidated by any change to the graph,
+  // including a new weight on an edge whose weights are kept in a FlatSet
+  template <typename It>
+  class View {
+   public:
+    View(It first, It last) : first_{first}, last_{last} {}
+
+    It begin() const { return first_; }
+    It end() const { return last_; }
+    bool empty() const { return first_ == last_; }
+
+   private:
+    It first_;
+    It last_;
+  };
+
+  class node_iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = N;
+    using reference = const N&;
+    using pointer = const N*;
+    using difference_type = std::ptrdiff_t;
+
+    reference operator*() const { return (*node_itr_)->value_; }
+    pointer operator->() const { return &(*node_itr_)->value_; }
+
+    node_iterator& operator++() {
+      ++node_itr_;
+      return *this;
+    }
+
+    node_iterator operator++(int) {
+      auto tmp{*this};
+      ++node_itr_;
+      return tmp;
+    }
+
+    node_iterator& operator--() {
+      --node_itr_;
+      return *this;
+    }
+
+    node_iterator operator--(int) {
+      auto tmp{*this};
+      --node_itr_;
+      return tmp;
+    }
+
+    friend bool operator==(const node_iterator& lhs, const node_iterator& rhs) {
+      return lhs.node_itr_ == rhs.node_itr_;
+    }
+
+    friend bool operator!=(const node_iterator& lhs, const node_iterator& rhs) {
+      return !(lhs == rhs);
+    }
+
+   private:
+    friend class Graph;
+
+    typename std::set<std::shared_ptr<Node>, CompareByValue<Node>>::const_iterator node_itr_;
+
+    explicit node_iterator(const decltype(node_itr_)& it) : node_itr_{it} {}
+  };
+
+  // skips destinations whose node has been deleted
+  class neighbor_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = N;
+    using reference = const N&;
+    using pointer = const N*;
+    using difference_type = std::ptrdiff_t;
+
+    reference operator*() const { return node_to_itr_->first.lock()->value_; }
+    pointer operator->() const { return &**this; }
+
+    neighbor_iterator& operator++() {
+      ++node_to_itr_;
+      SkipInvalid();
+      return *this;
+    }
+
+    neighbor_iterator operator++(int) {
+      auto tmp{*this};
+      ++(*this);
+      return tmp;
+    }
+
+    friend bool operator==(const neighbor_iterator& lhs, const neighbor_iterator& rhs) {
+      return lhs.node_to_itr_ == rhs.node_to_itr_;
+    }
+
+    friend bool operator!=(const neighbor_iterator& lhs, const neighbor_iterator& rhs) {
+      return !(lhs == rhs);
+    }
+
+   private:
+    friend class Graph;
+
+    typename std::map<std::weak_ptr<Node>, WeightSet, CompareByValue<Node>>::
+        const_iterator node_to_itr_;
+    typename std::map<std::weak_ptr<Node>, WeightSet, CompareByValue<Node>>::
+        const_iterator node_to_end_;
+
+    neighbor_iterator(const decltype(node_to_itr_)& to, const decltype(node_to_end_)& to_end)
+      : node_to_itr_{to}, node_to_end_{to_end} {
+      SkipInvalid();
+    }
+
+    void SkipInvalid() {
+      while (node_to_itr_ != node_to_end_ &&
+             (node_to_itr_->first.expired() || node_to_itr_->second.empty())) {
+        ++node_to_itr_;
       }
     }
-    return it1 == g1.end() && it2 == g2.end();
+  };
+
+  using weight_iterator = typename WeightSet::const_iterator;
+
+  // walks the edges in iterator order a bounded number at a time, so a long walk can be
+  // interleaved with other work; each step resumes after the last edge visited, so the graph
+  // may change between steps but not during one, and must outlive the walk
+  class EdgeWalk {
+   public:
+    explicit EdgeWalk(const Graph* graph) : graph_{graph} {}
+
+    // calls fn(src, dest, weight) for up to max_edges edges, false once the walk is finished
+    // a max_edges of 0 is taken as 1 so every step makes progress
+    template <typename F>
+    bool Step(F fn, std::size_t max_edges);
+    bool Done() const { return done_; }
+
+   private:
+    const Graph* graph_;
+    std::optional<std::tuple<N, N, E>> last_;
+    bool done_ = false;
+  };
+
+  // breadth first walk from a start node with the same stepping rules as EdgeWalk
+  // nodes deleted before they are reached are skipped
+  class BreadthFirstWalk {
+   public:
+    BreadthFirstWalk(const Graph* graph, const N& start)
+      : graph_{graph}, queue_{start}, seen_{start} {}
+
+    // calls fn(node) for nodes in breadth first order until at least max_edges edges
+    // have been examined, false once the walk is finished; 0 is taken as 1
+    template <typename F>
+    bool Step(F fn, std::size_t max_edges);
+    bool Done() const { return queue_.empty(); }
+
+   private:
+    const Graph* graph_;
+    std::deque<N> queue_;
+    std::set<N> seen_;
+  };
+
+  EdgeWalk WalkEdges() const;
+  BreadthFirstWalk WalkBreadthFirst(const N&) const;
+
+  View<node_iterator> Nodes() const;
+  View<neighbor_iterator> Neighbors(const N&) const;
+  View<weight_iterator> Weights(const N&, const N&) const;
+  View<const_iterator> EdgesFrom(const N&, const N&) const;
+
+  // aggregates and filters over numeric weights, scanning each edge's weights contiguously
+  E MinWeight(const N&) const;
+  E MaxWeight(const N&) const;
+  E SumWeights(const N&) const;
+  E SumWeights() const;
+  template <typename P>
+  std::vector<std::tuple<N, N, E>> EdgesWhere(P) const;
+
+  std::uint64_t ContentHash() const;
+
+  void EnableJournal(std::size_t capacity_bytes = 0);
+  void DisableJournal();
+  std::uint64_t JournalSequence() const;
+  std::string Delta(std::uint64_t) const;
+  void ApplyDelta(const std::string&);
+
+  // weakly connected components kept up to date as nodes and edges are inserted
+  void EnableComponentTracking();
+  void DisableComponentTracking();
+  bool SameComponent(const N&, const N&) const;
+  std::size_t ComponentCount() const;
+
+  // every weight kept in (weight, src, dst) order, answering range and top k queries in
+  // O(log E + k) instead of scanning each edge
+  void EnableWeightIndex();
+  void DisableWeightIndex();
+  std::vector<std::tuple<N, N, E>> EdgesInWeightRange(const E&, const E&) const;
+  std::vector<std::tuple<N, N, E>> TopKEdges(std::size_t) const;
+
+  friend bool operator==(const gdwg::Graph<N, E>& g1, const gdwg::Graph<N, E>& g2) {
+    return g1.Equals(g2);
   }
 
   friend bool operator!=(const gdwg::Graph<N, E>& g1, const gdwg::Graph<N, E>& g2) {
@@ -217,7 +761,209 @@ class Graph {
   }
 
  private:
+  // publishes images built from BuildAdjacency
+  friend class SharedImage<N, E>;
+
+  struct TopologicalState {
+    std::vector<const Node*> order;
+    std::unordered_map<const Node*, std::size_t> position;
+    std::size_t holes = 0;
+    bool valid = false;
+  };
+
+  // flat snapshot of the distinct destinations of each node, indexed in nodes_ order
+  struct Adjacency {
+    std::vector<const Node*> nodes;
+    std::unordered_map<const Node*, std::size_t> index;
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> targets;
+    // weights of each edge in targets, not kept by Transpose
+    std::vector<const WeightSet*> weights;
+
+    Adjacency Transpose() const;
+  };
+
+  static constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+  static constexpr std::size_t kSequentialComponentCutoff = 1024;
+  static constexpr std::size_t kSequentialRankCutoff = 4096;
+
+  enum class Mutation : char {
+    kInsertNode = 'n',
+    kInsertEdge = 'e',
+    kDeleteNode = 'd',
+    kReplace = 'r',
+    kMergeReplace = 'm',
+    kErase = 'x',
+    kClear = 'c',
+  };
+
+  // changes made to shared nodes through any of the graphs sharing them, which the others'
+  // counts, hash and indexes do not see
+  struct Sharing {
+    std::atomic<std::uint64_t> changes{0};
+  };
+
+  static constexpr std::uint64_t kUnordered = static_cast<std::uint64_t>(-1);
+
+  // mutation records in delta format, oldest first, numbered from first
+  struct Journal {
+    bool enabled = false;
+    std::size_t capacity = 0;
+    std::size_t bytes = 0;
+    std::uint64_t first = 0;
+    std::deque<std::string> records;
+  };
+
+  // most recently used ShortestPaths results first, keyed by (src, dst, k)
+  struct PathCache {
+    using Key = std::tuple<N, N, std::size_t>;
+    using Entry = std::pair<Key, std::vector<Path>>;
+
+    std::size_t capacity = 256;
+    std::list<Entry> entries;
+    std::map<Key, typename std::list<Entry>::iterator> index;
+  };
+
+  // union-find over the nodes, joined by every edge regardless of direction
+  struct Components {
+    bool enabled = false;
+    // union-find cannot split a set, so deletions mark it for rebuilding on the next query
+    bool stale = false;
+    std::unordered_map<const Node*, std::size_t> index;
+    std::vector<std::size_t> parent;
+    std::vector<std::size_t> size;
+    std::size_t count = 0;
+  };
+
+  // one weight of the edge from src to dst
+  struct WeightEntry {
+    E weight;
+    const Node* src;
+    const Node* dst;
+  };
+
+  // orders entries by (weight, src, dst), and finds them by weight alone
+  struct CompareByWeight {
+    using is_transparent = void;
+    bool operator()(const WeightEntry& lhs, const WeightEntry& rhs) const {
+      if (lhs.weight < rhs.weight || rhs.weight < lhs.weight) {
+        return lhs.weight < rhs.weight;
+      }
+      if (lhs.src->value_ < rhs.src->value_ || rhs.src->value_ < lhs.src->value_) {
+        return lhs.src->value_ < rhs.src->value_;
+      }
+      return lhs.dst->value_ < rhs.dst->value_;
+    }
+    bool operator()(const WeightEntry& lhs, const E& rhs) const { return lhs.weight < rhs; }
+    bool operator()(const E& lhs, const WeightEntry& rhs) const { return lhs < rhs.weight; }
+  };
+
+  struct WeightIndex {
+    bool enabled = false;
+    // set when a mutation could not be applied to the index, which is rebuilt on the next query
+    bool stale = false;
+    std::set<WeightEntry, CompareByWeight> entries;
+  };
+
+  using NodeItr = typename std::set<std::shared_ptr<Node>, CompareByValue<Node>>::const_iterator;
+  using EdgeItr = typename std::map<std::weak_ptr<Node>, WeightSet, CompareByValue<Node>>::iterator;
+
+  const_iterator Seek(NodeItr, EdgeItr) const;
+  NodeItr LowerBoundNode(const N&) const;
+
+  template <typename F>
+  static void ForEachEdgeIn(NodeItr, NodeItr, F&);
+  std::vector<std::pair<NodeItr, NodeItr>> PartitionByEdges(unsigned int) const;
+  template <typename F, typename S>
+  void RunPartitioned(unsigned int, F, S) const;
+  template <typename F>
+  static void RunChunks(std::size_t, unsigned int, F);
+
+  bool Aliased() const;
+  bool Resync(std::uint64_t) const;
+  void NoteSharedChange();
+  NodeItr FindNode(const N&) const;
+  // the node of this graph an edge to a node only a copy holds leads to, matched by value
+  const Node* ResolveNode(const Node*) const;
+  static void PurgeExpiredEdges(Node&);
+  template <typename V>
+  std::pair<NodeItr, bool> AddNode(V&&);
+  template <typename V>
+  bool Rename(const N&, V&&);
+  void DropNode(NodeItr);
+  bool Equals(const Graph<N, E>&) const;
+  static std::uint64_t NodeHash(const N&);
+  static std::uint64_t EdgeHash(const N&, const N&, const E&);
+  static std::uint64_t Mix(std::uint64_t);
+  std::uint64_t HashContent() const;
+  static std::size_t CountOut(const Node&);
+  static E SumRun(const E*, std::size_t);
+  void RebuildIndexes() const;
+
+  template <typename... Args>
+  void Record(Mutation, const Args&...);
+  void RestartJournal() noexcept;
+
+  void TrackNode(const Node*) const;
+  void UniteNodes(const Node*, const Node*) const;
+  std::size_t FindRoot(std::size_t) const;
+  void RebuildComponents() const;
+  bool IndexingWeights() const;
+  void IndexWeight(E, const Node*, const Node*);
+  void UnindexWeight(const E&, const Node*, const Node*);
+  void RebuildWeightIndex() const;
+  template <typename F, typename M>
+  void ResolveBatch(const std::vector<std::pair<N, N>>&, unsigned int, F, M) const;
+
+  template <typename W>
+  bool LinkNodes(const std::shared_ptr<Node>&, const std::shared_ptr<Node>&, W&&);
+  bool SortTopologically(std::vector<const Node*>&, std::vector<const Node*>&) const;
+  bool CacheTopologicalOrder() const;
+  void ReorderAfterInsert(const Node*, const Node*);
+  void ForgetNode(const Node*);
+
+  Adjacency BuildAdjacency() const;
+  template <typename P, typename F>
+  static void Tarjan(const Adjacency&,
+                     const std::vector<std::size_t>&,
+                     P,
+                     F,
+                     std::vector<std::size_t>&,
+                     std::vector<std::size_t>&,
+                     std::vector<std::size_t>&);
+  static std::vector<std::vector<N>> GroupComponents(const Adjacency&,
+                                                     const std::vector<std::size_t>&);
+
+  std::vector<Path> FindShortestPaths(const N&, const N&, std::size_t) const;
+  template <typename P, typename Q>
+  Graph<N, E> Extract(P, Q) const;
+  template <typename P>
+  void ForgetPathsWhere(P);
+  void ForgetPaths() const;
+  void ForgetPathsThrough(const Node*, const Node*, const E&);
+  std::unordered_map<const Node*, E> CostsFrom(const Node*, std::optional<E>, const Node*) const;
+
   std::set<std::shared_ptr<Node>, CompareByValue<Node>> nodes_;
+  mutable TopologicalState topo_;
+  mutable std::mutex topo_mutex_;
+  // held by this graph and every copy sharing its nodes
+  std::shared_ptr<Sharing> sharing_ = std::make_shared<Sharing>();
+  // sharing_->changes when the counts, hash and indexes were last made to agree with the
+  // nodes, or kUnordered once a rename through a copy left nodes_ out of order
+  mutable std::atomic<std::uint64_t> synced_{0};
+  mutable std::mutex sharing_mutex_;
+  Journal journal_;
+  // sum of NodeHash and EdgeHash over the graph, kept up to date by every mutation
+  mutable std::uint64_t content_hash_ = 0;
+  // number of weights over all edges, each counted as a separate edge
+  mutable std::size_t edge_count_ = 0;
+  // not used while nodes are shared with a copy, whose changes it would not see
+  mutable PathCache path_cache_;
+  mutable std::mutex path_cache_mutex_;
+  mutable Components components_;
+  mutable std::mutex components_mutex_;
+  mutable WeightIndex weight_index_;
+  mutable std::mutex weight_index_mutex_;
 };
 
 }  // namespace gdwg
@@ -1,15 +1,27 @@
 #include "assignments/dg/graph.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <iostream>
 #include <iterator>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <set>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -29,7 +41,7 @@ gdwg::Graph<N, E>::Graph(typename std::vector<N>::const_iterator begin,
   : nodes_{std::set<std::shared_ptr<Node>, CompareByValue<Node>>{}} {
   int len = end - begin;
   for (int i = 0; i < len; ++i) {
-    nodes_.emplace(std::make_shared<Node>(*begin++));
+    AddNode(*begin++);
   }
 }
 
@@ -44,7 +56,7 @@ gdwg::Graph<N, E>::Graph(typename std::vector<std::tuple<N, N, E>>::const_iterat
   : nodes_{std::set<std::shared_ptr<Node>, CompareByValue<Node>>{}} {
   int len = end - begin;
   for (int i = 0; i < len; ++i) {
-    auto [src, dest, cost] = *begin++;
+    const auto& [src, dest, cost] = *begin++;
     InsertNode(src);
     InsertNode(dest);
     InsertEdge(src, dest, cost);
@@ -59,28 +71,73 @@ template <typename N, typename E>
 gdwg::Graph<N, E>::Graph(std::initializer_list<N> list)
   : nodes_{std::set<std::shared_ptr<Node>, CompareByValue<Node>>{}} {
   for (const auto& n : list) {
-    auto ptr = std::make_shared<Node>(n);
-    nodes_.emplace(ptr);
+    AddNode(n);
+  }
+}
+
+/*
+    Constructor
+    constructs graph from a vector of node values, moving each value out of it
+*/
+template <typename N, typename E>
+gdwg::Graph<N, E>::Graph(std::vector<N>&& values)
+  : nodes_{std::set<std::shared_ptr<Node>, CompareByValue<Node>>{}} {
+  for (auto& val : values) {
+    AddNode(std::move(val));
+  }
+}
+
+/*
+    Constructor
+    constructs graph from a vector of tuples of source node, destination node, and weight,
+    moving each value out of it the first time it is added to the graph
+*/
+template <typename N, typename E>
+gdwg::Graph<N, E>::Graph(std::vector<std::tuple<N, N, E>>&& edges)
+  : nodes_{std::set<std::shared_ptr<Node>, CompareByValue<Node>>{}} {
+  for (auto& [src, dest, cost] : edges) {
+    auto src_it = AddNode(std::move(src)).first;
+    auto dst_it = AddNode(std::move(dest)).first;
+    LinkNodes(*src_it, *dst_it, std::move(cost));
   }
 }
 
 /*
     Copy Constructor
+    shares the nodes with g, whose counts, hash and indexes stay valid until either graph
+    changes a shared node
 */
 template <typename N, typename E>
 gdwg::Graph<N, E>::Graph(const gdwg::Graph<N, E>& g)
-  : nodes_{std::set<std::shared_ptr<Node>, CompareByValue<Node>>{}} {
+  : nodes_{std::set<std::shared_ptr<Node>, CompareByValue<Node>>{}}, sharing_{g.sharing_}, synced_{g.synced_.load()}, content_hash_{g.content_hash_},
+    edge_count_{g.edge_count_} {
   for (const auto& node : g.nodes_) {
     std::shared_ptr<Node> n = node;
     this->nodes_.emplace(n);
   }
+  std::lock_guard<std::mutex> lock{g.topo_mutex_};
+  topo_ = g.topo_;
 }
 
 /*
     Move Constructor
 */
 template <typename N, typename E>
-gdwg::Graph<N, E>::Graph(gdwg::Graph<N, E>&& g) noexcept : nodes_{std::move(g.nodes_)} {}
+gdwg::Graph<N, E>::Graph(gdwg::Graph<N, E>&& g) noexcept
+  : nodes_{std::move(g.nodes_)}, topo_{std::move(g.topo_)}, synced_{g.synced_.load()},
+    journal_{std::move(g.journal_)}, content_hash_{g.content_hash_}, edge_count_{g.edge_count_},
+    path_cache_{std::move(g.path_cache_)}, components_{std::move(g.components_)},
+    weight_index_{std::move(g.weight_index_)} {
+  std::swap(sharing_, g.sharing_);
+  g.synced_ = 0;
+  g.topo_ = TopologicalState{};
+  g.journal_ = Journal{};
+  g.content_hash_ = 0;
+  g.edge_count_ = 0;
+  g.ForgetPaths();
+  g.components_ = Components{};
+  g.weight_index_ = WeightIndex{};
+}
 
 /*
     Copy Assignment
@@ -92,274 +149,3338 @@ gdwg::Graph<N, E>& gdwg::Graph<N, E>::operator=(const gdwg::Graph<N, E>& g) {
     std::shared_ptr<Node> n = node;
     this->nodes_.emplace(n);
   }
+  {
+    std::lock_guard<std::mutex> lock{g.topo_mutex_};
+    this->topo_ = g.topo_;
+  }
+  this->sharing_ = g.sharing_;
+  this->synced_ = g.synced_.load();
+  this->content_hash_ = g.content_hash_;
+  this->edge_count_ = g.edge_count_;
+  ForgetPaths();
+  components_.stale = true;
+  weight_index_.stale = true;
+
+  // replayed as clearing the graph and inserting everything in g
+  if (journal_.enabled) {
+    Record(Mutation::kClear);
+    for (const auto& node : nodes_) {
+      Record(Mutation::kInsertNode, node->value_);
+    }
+    ForEachEdge([this](const N& src, const N& dest, const E& w) {
+      Record(Mutation::kInsertEdge, src, dest, w);
+    });
+  }
+  return *this;
+}
+
+/*
+    Move Assignment
+    records cannot be allocated here, so both journals are restarted instead
+*/
+template <typename N, typename E>
+gdwg::Graph<N, E>& gdwg::Graph<N, E>::operator=(gdwg::Graph<N, E>&& g) noexcept {
+  this->nodes_ = std::move(g.nodes_);
+  this->topo_ = std::move(g.topo_);
+  this->sharing_ = std::move(g.sharing_);
+  this->synced_ = g.synced_.load();
+  this->content_hash_ = g.content_hash_;
+  this->edge_count_ = g.edge_count_;
+  this->path_cache_ = std::move(g.path_cache_);
+  this->components_ = std::move(g.components_);
+  this->weight_index_ = std::move(g.weight_index_);
+  g.sharing_ = std::make_shared<Sharing>();
+  g.synced_ = 0;
+  g.topo_ = TopologicalState{};
+  g.content_hash_ = 0;
+  g.edge_count_ = 0;
+  g.ForgetPaths();
+  g.components_ = Components{};
+  g.weight_index_ = WeightIndex{};
+  RestartJournal();
+  g.RestartJournal();
   return *this;
 }
 
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::InsertNode(const N& val) {
+  return AddNode(val).second;
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::InsertNode(N&& val) {
+  return AddNode(std::move(val)).second;
+}
+
+/*
+    Adds a node holding val unless one already exists, checking before anything is allocated
+    val is only moved from when the node is added
+*/
+template <typename N, typename E>
+template <typename V>
+std::pair<typename gdwg::Graph<N, E>::NodeItr, bool> gdwg::Graph<N, E>::AddNode(V&& val) {
+  auto hint = nodes_.lower_bound(val);
+  if (hint != nodes_.end() && !(val < (*hint)->value_)) {
+    return {hint, false};
+  }
+  if (Aliased()) {
+    auto found = FindNode(val);
+    if (found != nodes_.end()) {
+      return {found, false};
+    }
+  }
+
+  NodeItr it = nodes_.emplace_hint(hint, std::make_shared<Node>(std::forward<V>(val)));
+  Node* added = it->get();
+  if (topo_.valid) {
+    topo_.position.emplace(added, topo_.order.size());
+    topo_.order.push_back(added);
+  }
+  content_hash_ += NodeHash(added->value_);
+  TrackNode(added);
+  Record(Mutation::kInsertNode, added->value_);
+  return {it, true};
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::InsertEdge(const N& src, const N& dest, const E& w) {
+  auto src_it = FindNode(src);
+  auto dst_it = FindNode(dest);
+  if (src_it == nodes_.end() || dst_it == nodes_.end()) {
+    throw std::runtime_error(
+        "Cannot call Graph::InsertEdge when either src or dst node does not exist");
+  }
+
+  if (!LinkNodes(*src_it, *dst_it, w)) {
+    return false;
+  }
+
+  Record(Mutation::kInsertEdge, src, dest, w);
+  return true;
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::InsertEdge(const N& src, const N& dest, E&& w) {
+  // the journal needs the weight after it is inserted, so keep the caller's copy
+  if (journal_.enabled) {
+    return InsertEdge(src, dest, static_cast<const E&>(w));
+  }
+
+  auto src_it = FindNode(src);
+  auto dst_it = FindNode(dest);
+  if (src_it == nodes_.end() || dst_it == nodes_.end()) {
+    throw std::runtime_error(
+        "Cannot call Graph::InsertEdge when either src or dst node does not exist");
+  }
+
+  return LinkNodes(*src_it, *dst_it, std::move(w));
+}
+
+/*
+    Builds a temporary from args and moves it into InsertNode or InsertEdge
+    the value has to exist before it can be checked against the graph, so it is not built
+    directly in the node or weight storage
+*/
+template <typename N, typename E>
+template <typename... Args>
+bool gdwg::Graph<N, E>::EmplaceNode(Args&&... args) {
+  return InsertNode(N(std::forward<Args>(args)...));
+}
+
+template <typename N, typename E>
+template <typename... Args>
+bool gdwg::Graph<N, E>::EmplaceEdge(const N& src, const N& dest, Args&&... args) {
+  return InsertEdge(src, dest, E(std::forward<Args>(args)...));
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::DeleteNode(const N& n) {
+  auto n_it = FindNode(n);
+  if (n_it == nodes_.end()) {
+    return false;
+  }
+
+  DropNode(n_it);
+  components_.stale = true;
+  Record(Mutation::kDeleteNode, n);
+  return true;
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::Replace(const N& oldData, const N& newData) {
+  return Rename(oldData, newData);
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::Replace(const N& oldData, N&& newData) {
+  return Rename(oldData, std::move(newData));
+}
+
+/*
+    Gives the node holding oldData the value newData, which is only moved from on success
+*/
+template <typename N, typename E>
+template <typename V>
+bool gdwg::Graph<N, E>::Rename(const N& oldData, V&& newData) {
+  auto it = FindNode(oldData);
+  if (it == nodes_.end()) {
+    throw std::runtime_error("Cannot call Graph::Replace on a node that doesn't exist");
+  }
+
+  if (IsNode(newData)) {
+    return false;
+  }
+
+  // take the node and every edge to it out of their ordered containers while the
+  // old value still finds them, then put them back under the new value
+  Node* renamed = it->get();
+  const bool aliased = Aliased();
+  if (aliased) {
+    // an edge a copy left to a node it dropped compares equal to every other edge, and
+    // would stop the edges taken out below from going back in
+    for (const auto& node : nodes_) {
+      PurgeExpiredEdges(*node);
+      auto edge = Node::FindEdgeIn(node->edges_out_, oldData, true);
+      if (edge != node->edges_out_.end() && edge->first.lock().get() == renamed &&
+          Node::FindEdgeIn(node->edges_out_, newData, true) != node->edges_out_.end()) {
+        throw std::runtime_error("Cannot call Graph::Replace if a copy sharing the nodes has "
+                                 "an edge to newData from a node with an edge to oldData");
+      }
+    }
+  }
+  std::vector<std::pair<Node*, typename decltype(Node::edges_out_)::node_type>> incoming;
+  for (const auto& node : nodes_) {
+    auto edge = Node::FindEdgeIn(node->edges_out_, oldData, aliased);
+    if (edge != node->edges_out_.end() && edge->first.lock().get() == renamed) {
+      incoming.emplace_back(node.get(), node->edges_out_.extract(edge));
+    }
+  }
+
+  // rehash and reindex the node and every edge touching it, a self loop is only in
+  // incoming by now
+  auto rehash = [this, renamed, &incoming](bool add) {
+    auto update = [this, add](std::uint64_t h) { content_hash_ += add ? h : 0 - h; };
+    auto reindex = [this, add](const E& cost, const Node* src, const Node* dst) {
+      add ? IndexWeight(cost, src, dst) : UnindexWeight(cost, src, dst);
+    };
+    update(NodeHash(renamed->value_));
+    for (const auto& [edge_to, costs] : renamed->edges_out_) {
+      if (std::shared_ptr<Node> dest = edge_to.lock()) {
+        for (const auto& cost : costs) {
+          update(EdgeHash(renamed->value_, dest->value_, cost));
+          reindex(cost, renamed, dest.get());
+        }
+      }
+    }
+    for (const auto& [node, edge] : incoming) {
+      for (const auto& cost : edge.mapped()) {
+        update(EdgeHash(node->value_, renamed->value_, cost));
+        reindex(cost, node, renamed);
+      }
+    }
+  };
+
+  rehash(false);
+  auto handle = nodes_.extract(it);
+  handle.value()->SetValue(std::forward<V>(newData));
+  nodes_.insert(std::move(handle));
+  rehash(true);
+
+  // with the checks above no edge already leads to the new value, so every insert succeeds
+  for (auto& [node, edge] : incoming) {
+    node->edges_out_.insert(std::move(edge));
+  }
+
+  // renaming can change which of several equally cheap paths sort first
+  ForgetPaths();
+  NoteSharedChange();
+
+  Record(Mutation::kReplace, oldData, renamed->value_);
+  return true;
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::MergeReplace(const N& oldData, const N& newData) {
+  auto old_it = FindNode(oldData);
+  auto new_it = FindNode(newData);
+  if (old_it == nodes_.end() || new_it == nodes_.end()) {
+    throw std::runtime_error(
+        "Cannot call Graph::MergeReplace on old or new data if they don't exist in the graph");
+  }
+
+  // merge outgoing edges
+  auto pair = old_it->get()->EdgesWeights();
+  for (const auto& ew : pair) {
+    std::shared_ptr<Node> node = ew.first.lock();
+    if (!node) {
+      continue;
+    }
+
+    for (const auto& cost : ew.second) {
+      LinkNodes(*new_it, node, cost);
+    }
+  }
+
+  // merge incoming edges
+  const bool aliased = Aliased();
+  for (const auto& node : nodes_) {
+    if (!node->IsEdge(oldData, aliased)) {
+      continue;
+    }
+
+    auto weights = node->GetWeights(oldData, aliased);
+
+    for (const auto& weight : weights) {
+      LinkNodes(node, *new_it, weight);
+    }
+  }
+
+  // every edge of the old node now touches the new one, so removing it splits nothing
+  const Node* merged = old_it->get();
+  UniteNodes(merged, new_it->get());
+  DropNode(old_it);
+  components_.index.erase(merged);
+  ForgetPaths();
+  Record(Mutation::kMergeReplace, oldData, newData);
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::Clear() {
+  for (auto itr = nodes_.begin(); itr != nodes_.end();) {
+    itr = nodes_.erase(itr);
+  }
+  topo_ = TopologicalState{};
+  // none of the nodes are shared any more
+  sharing_ = std::make_shared<Sharing>();
+  synced_ = 0;
+  content_hash_ = 0;
+  edge_count_ = 0;
+  ForgetPaths();
+  const bool tracking = components_.enabled;
+  components_ = Components{};
+  components_.enabled = tracking;
+  weight_index_.entries.clear();
+  weight_index_.stale = false;
+  Record(Mutation::kClear);
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::IsNode(const N& val) const {
+  return FindNode(val) != nodes_.end();
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::IsConnected(const N& src, const N& dest) const {
+  auto src_it = FindNode(src);
+  if (src_it == nodes_.end() || !IsNode(dest)) {
+    throw std::runtime_error(
+        "Cannot call Graph::IsConnected if src or dst node don't exist in the graph");
+  }
+
+  return src_it->get()->IsEdge(dest, Aliased());
+}
+
+template <typename N, typename E>
+std::vector<N> gdwg::Graph<N, E>::GetNodes() const {
+  std::vector<N> v;
+  v.reserve(nodes_.size());
+  for (const auto& n : this->nodes_) {
+    v.push_back(n->GetValue());
+  }
+  // only a rename through a copy sharing these nodes can leave them out of order
+  if (!std::is_sorted(v.begin(), v.end())) {
+    std::sort(v.begin(), v.end());
+  }
+  return v;
+}
+
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::NodeCount() const {
+  return nodes_.size();
+}
+
+/*
+    Gets the number of edges, counting each weight between two nodes as an edge
+    graphs sharing nodes with a copy can be changed through the copy and so count in full
+*/
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::EdgeCount() const {
+  if (!Aliased()) {
+    return edge_count_;
+  }
+
+  std::size_t count = 0;
+  for (const auto& node : nodes_) {
+    count += CountOut(*node);
+  }
+  return count;
+}
+
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::OutDegree(const N& n) const {
+  auto it = FindNode(n);
+  if (it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::OutDegree if the node doesn't exist in the graph");
+  }
+
+  return Aliased() ? CountOut(**it) : it->get()->out_degree_;
+}
+
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::InDegree(const N& n) const {
+  auto it = FindNode(n);
+  if (it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::InDegree if the node doesn't exist in the graph");
+  }
+
+  if (!Aliased()) {
+    return it->get()->in_degree_;
+  }
+
+  // by value, like iteration, as a copy can leave edges to a node of its own holding n
+  std::size_t count = 0;
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (dest && dest->value_ == n) {
+        count += costs.size();
+      }
+    }
+  }
+  return count;
+}
+
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::CountOut(const Node& node) {
+  std::size_t count = 0;
+  for (const auto& [edge_to, costs] : node.edges_out_) {
+    if (!edge_to.expired()) {
+      count += costs.size();
+    }
+  }
+  return count;
+}
+
+/*
+    Recomputes the content hash, edge count and degrees after the nodes were built directly
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::RebuildIndexes() const {
+  content_hash_ = HashContent();
+  edge_count_ = 0;
+  for (const auto& node : nodes_) {
+    node->out_degree_ = CountOut(*node);
+    node->in_degree_ = 0;
+    edge_count_ += node->out_degree_;
+  }
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      if (std::shared_ptr<Node> dest = edge_to.lock()) {
+        dest->in_degree_ += costs.size();
+      }
+    }
+  }
+}
+
+template <typename N, typename E>
+std::vector<N> gdwg::Graph<N, E>::GetConnected(const N& src) const {
+  auto src_it = FindNode(src);
+  if (src_it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::GetConnected if src doesn't exist in the graph");
+  }
+
+  return src_it->get()->GetEdges();
+}
+
+template <typename N, typename E>
+std::vector<E> gdwg::Graph<N, E>::GetWeights(const N& src, const N& dest) const {
+  auto src_it = FindNode(src);
+  if (src_it == nodes_.end() || !IsNode(dest)) {
+    throw std::out_of_range(
+        "Cannot call Graph::GetWeights if src or dst node don't exist in the graph");
+  }
+
+  return src_it->get()->GetWeights(dest, Aliased());
+}
+
+/*
+    Views over the nodes, the destinations of src, and the weights from src to dest
+    iterate the graph in place in ascending order without copying or sorting
+*/
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::template View<typename gdwg::Graph<N, E>::node_iterator>
+gdwg::Graph<N, E>::Nodes() const {
+  return {node_iterator{nodes_.cbegin()}, node_iterator{nodes_.cend()}};
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::template View<typename gdwg::Graph<N, E>::neighbor_iterator>
+gdwg::Graph<N, E>::Neighbors(const N& src) const {
+  auto src_it = FindNode(src);
+  if (src_it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::Neighbors if src doesn't exist in the graph");
+  }
+
+  const auto& edges = src_it->get()->edges_out_;
+  return {neighbor_iterator{edges.cbegin(), edges.cend()},
+          neighbor_iterator{edges.cend(), edges.cend()}};
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::template View<typename gdwg::Graph<N, E>::weight_iterator>
+gdwg::Graph<N, E>::Weights(const N& src, const N& dest) const {
+  auto src_it = FindNode(src);
+  if (src_it == nodes_.end() || !IsNode(dest)) {
+    throw std::out_of_range(
+        "Cannot call Graph::Weights if src or dst node don't exist in the graph");
+  }
+
+  const auto& edges = src_it->get()->edges_out_;
+  auto edge = Node::FindEdgeIn(edges, dest, Aliased());
+  if (edge == edges.end()) {
+    return {weight_iterator{}, weight_iterator{}};
+  }
+  return {edge->second.cbegin(), edge->second.cend()};
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::EdgeWalk gdwg::Graph<N, E>::WalkEdges() const {
+  return EdgeWalk{this};
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::BreadthFirstWalk
+gdwg::Graph<N, E>::WalkBreadthFirst(const N& start) const {
+  if (FindNode(start) == nodes_.end()) {
+    throw std::out_of_range(
+        "Cannot call Graph::WalkBreadthFirst if the node doesn't exist in the graph");
+  }
+
+  return BreadthFirstWalk{this, start};
+}
+
+/*
+    Finds the first edge after the last one visited by looking up its nodes and weight again
+    rather than keeping iterators, which any change to the graph between steps could invalidate
+*/
+template <typename N, typename E>
+template <typename F>
+bool gdwg::Graph<N, E>::EdgeWalk::Step(F fn, std::size_t max_edges) {
+  if (done_) {
+    return false;
+  }
+  max_edges = std::max<std::size_t>(max_edges, 1);
+
+  // a copy sharing these nodes can leave them out of order, which LowerBoundNode allows for
+  const auto& nodes = graph_->nodes_;
+  auto node_it = last_ ? graph_->LowerBoundNode(std::get<0>(*last_)) : nodes.begin();
+  std::size_t visited = 0;
+  for (; node_it != nodes.end(); ++node_it) {
+    const Node& src = **node_it;
+    const auto& edges = src.edges_out_;
+    bool resume = last_ && !(std::get<0>(*last_) < src.value_);
+    auto edge_it = edges.begin();
+    if (resume) {
+      const N& dest = std::get<1>(*last_);
+      edge_it = graph_->Aliased()
+                    ? std::find_if(edges.begin(), edges.end(),
+                                   [&dest](const auto& e) {
+                                     std::shared_ptr<Node> to = e.first.lock();
+                                     return to && !(to->value_ < dest);
+                                   })
+                    : edges.lower_bound(dest);
+    }
+
+    for (; edge_it != edges.end(); ++edge_it) {
+      std::shared_ptr<Node> dest = edge_it->first.lock();
+      if (!dest) {
+        continue;
+      }
+      const auto& costs = edge_it->second;
+      auto cost_it = costs.begin();
+      if (resume && !(std::get<1>(*last_) < dest->value_)) {
+        cost_it = costs.upper_bound(std::get<2>(*last_));
+      }
+      for (; cost_it != costs.end(); ++cost_it) {
+        fn(src.value_, dest->value_, *cost_it);
+        if (++visited == max_edges) {
+          last_.emplace(src.value_, dest->value_, *cost_it);
+          return true;
+        }
+      }
+    }
+  }
+
+  done_ = true;
+  return false;
+}
+
+/*
+    Expands whole nodes, so a step may examine up to one node's edges more than max_edges
+*/
+template <typename N, typename E>
+template <typename F>
+bool gdwg::Graph<N, E>::BreadthFirstWalk::Step(F fn, std::size_t max_edges) {
+  max_edges = std::max<std::size_t>(max_edges, 1);
+  std::size_t examined = 0;
+  while (!queue_.empty() && examined < max_edges) {
+    auto node_it = graph_->FindNode(queue_.front());
+    queue_.pop_front();
+    if (node_it == graph_->nodes_.end()) {
+      continue;
+    }
+
+    fn((*node_it)->value_);
+    for (const auto& [edge_to, costs] : (*node_it)->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest) {
+        continue;
+      }
+      ++examined;
+      if (seen_.insert(dest->value_).second) {
+        queue_.push_back(dest->value_);
+      }
+    }
+  }
+  return !queue_.empty();
+}
+
+/*
+    Smallest and largest weight on the edges out of n
+    each edge keeps its weights sorted, so only the first or last weight of each edge is read
+*/
+template <typename N, typename E>
+E gdwg::Graph<N, E>::MinWeight(const N& n) const {
+  static_assert(std::is_arithmetic<E>::value, "Graph::MinWeight requires numeric weights");
+  auto it = FindNode(n);
+  if (it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::MinWeight if the node doesn't exist in the graph");
+  }
+
+  bool found = false;
+  E result{};
+  for (const auto& [edge_to, costs] : it->get()->edges_out_) {
+    if (!edge_to.expired() && !costs.empty() && (!found || costs.data()[0] < result)) {
+      result = costs.data()[0];
+      found = true;
+    }
+  }
+  if (!found) {
+    throw std::runtime_error("Cannot call Graph::MinWeight on a node without outgoing edges");
+  }
+  return result;
+}
+
+template <typename N, typename E>
+E gdwg::Graph<N, E>::MaxWeight(const N& n) const {
+  static_assert(std::is_arithmetic<E>::value, "Graph::MaxWeight requires numeric weights");
+  auto it = FindNode(n);
+  if (it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::MaxWeight if the node doesn't exist in the graph");
+  }
+
+  bool found = false;
+  E result{};
+  for (const auto& [edge_to, costs] : it->get()->edges_out_) {
+    if (!edge_to.expired() && !costs.empty() &&
+        (!found || result < costs.data()[costs.size() - 1])) {
+      result = costs.data()[costs.size() - 1];
+      found = true;
+    }
+  }
+  if (!found) {
+    throw std::runtime_error("Cannot call Graph::MaxWeight on a node without outgoing edges");
+  }
+  return result;
+}
+
+/*
+    Sum of the weights on the edges out of n, or on every edge in the graph
+*/
+template <typename N, typename E>
+E gdwg::Graph<N, E>::SumWeights(const N& n) const {
+  static_assert(std::is_arithmetic<E>::value, "Graph::SumWeights requires numeric weights");
+  auto it = FindNode(n);
+  if (it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::SumWeights if the node doesn't exist in the graph");
+  }
+
+  E sum{};
+  for (const auto& [edge_to, costs] : it->get()->edges_out_) {
+    if (!edge_to.expired()) {
+      sum += SumRun(costs.data(), costs.size());
+    }
+  }
+  return sum;
+}
+
+template <typename N, typename E>
+E gdwg::Graph<N, E>::SumWeights() const {
+  static_assert(std::is_arithmetic<E>::value, "Graph::SumWeights requires numeric weights");
+  E sum{};
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      if (!edge_to.expired()) {
+        sum += SumRun(costs.data(), costs.size());
+      }
+    }
+  }
+  return sum;
+}
+
+/*
+    Every edge whose weight satisfies pred, in iterator order
+    pred is called once per weight, reading each edge's weights straight from their
+    contiguous storage; an arbitrary predicate isn't batched or split into lanes like SumRun
+*/
+template <typename N, typename E>
+template <typename P>
+std::vector<std::tuple<N, N, E>> gdwg::Graph<N, E>::EdgesWhere(P pred) const {
+  static_assert(std::is_arithmetic<E>::value, "Graph::EdgesWhere requires numeric weights");
+  std::vector<std::tuple<N, N, E>> result;
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest) {
+        continue;
+      }
+      const E* first = costs.data();
+      for (std::size_t i = 0; i < costs.size(); ++i) {
+        if (pred(first[i])) {
+          result.emplace_back(node->value_, dest->value_, first[i]);
+        }
+      }
+    }
+  }
+  return result;
+}
+
+/*
+    Every edge with a weight between lo and hi inclusive, in (weight, src, dst) order
+    read off the weight index when enabled, otherwise the sorted weights of each edge are
+    cut with a binary search instead of testing each one
+*/
+template <typename N, typename E>
+std::vector<std::tuple<N, N, E>> gdwg::Graph<N, E>::EdgesInWeightRange(const E& lo,
+                                                                        const E& hi) const {
+  std::vector<std::tuple<N, N, E>> result;
+  if (hi < lo) {
+    return result;
+  }
+
+  if (weight_index_.enabled) {
+    const bool aliased = Aliased();
+    std::lock_guard<std::mutex> lock{weight_index_mutex_};
+    if (weight_index_.stale || aliased) {
+      RebuildWeightIndex();
+    }
+    const auto& entries = weight_index_.entries;
+    for (auto it = entries.lower_bound(lo), last = entries.upper_bound(hi); it != last; ++it) {
+      result.emplace_back(it->src->value_, it->dst->value_, it->weight);
+    }
+    return result;
+  }
+
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest) {
+        continue;
+      }
+      auto first = std::lower_bound(costs.begin(), costs.end(), lo);
+      auto last = std::upper_bound(first, costs.end(), hi);
+      for (; first != last; ++first) {
+        result.emplace_back(node->value_, dest->value_, *first);
+      }
+    }
+  }
+  // already in (src, dst) order, which a stable sort keeps among equal weights
+  std::stable_sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+    return std::get<2>(lhs) < std::get<2>(rhs);
+  });
+  return result;
+}
+
+/*
+    The k heaviest edges, in descending (weight, src, dst) order
+    read off the end of the weight index when enabled, otherwise the edges are scanned
+    keeping the k heaviest seen in a heap
+*/
+template <typename N, typename E>
+std::vector<std::tuple<N, N, E>> gdwg::Graph<N, E>::TopKEdges(std::size_t k) const {
+  using Edge = std::tuple<N, N, E>;
+  std::vector<Edge> result;
+  if (k == 0) {
+    return result;
+  }
+
+  if (weight_index_.enabled) {
+    const bool aliased = Aliased();
+    std::lock_guard<std::mutex> lock{weight_index_mutex_};
+    if (weight_index_.stale || aliased) {
+      RebuildWeightIndex();
+    }
+    const auto& entries = weight_index_.entries;
+    for (auto it = entries.rbegin(); it != entries.rend() && result.size() < k; ++it) {
+      result.emplace_back(it->src->value_, it->dst->value_, it->weight);
+    }
+    return result;
+  }
+
+  // a heap with the lightest of the edges kept so far on top
+  auto heavier = [](const Edge& lhs, const Edge& rhs) {
+    return std::tie(std::get<2>(rhs), std::get<0>(rhs), std::get<1>(rhs)) <
+           std::tie(std::get<2>(lhs), std::get<0>(lhs), std::get<1>(lhs));
+  };
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest) {
+        continue;
+      }
+      for (const auto& cost : costs) {
+        if (result.size() == k && cost < std::get<2>(result.front())) {
+          continue;
+        }
+        Edge edge{node->value_, dest->value_, cost};
+        if (result.size() < k) {
+          result.push_back(std::move(edge));
+          std::push_heap(result.begin(), result.end(), heavier);
+        } else if (heavier(edge, result.front())) {
+          std::pop_heap(result.begin(), result.end(), heavier);
+          result.back() = std::move(edge);
+          std::push_heap(result.begin(), result.end(), heavier);
+        }
+      }
+    }
+  }
+  std::sort_heap(result.begin(), result.end(), heavier);
+  return result;
+}
+
+/*
+    Sums count contiguous weights into four independent accumulators
+    so the additions do not form one dependency chain and the loop can be vectorised
+*/
+template <typename N, typename E>
+E gdwg::Graph<N, E>::SumRun(const E* first, std::size_t count) {
+  E lanes[4] = {};
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    lanes[0] += first[i];
+    lanes[1] += first[i + 1];
+    lanes[2] += first[i + 2];
+    lanes[3] += first[i + 3];
+  }
+  E sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < count; ++i) {
+    sum += first[i];
+  }
+  return sum;
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::erase(const N& src, const N& dest, const E& w) {
+  auto src_itr = FindNode(src);
+  auto dst_itr = FindNode(dest);
+  if (src_itr == nodes_.end() || dst_itr == nodes_.end()) {
+    return false;
+  }
+
+  auto& edges = src_itr->get()->edges_out_;
+  auto edge = Node::FindEdgeIn(edges, dest, Aliased());
+  if (edge == edges.end()) {
+    return false;
+  }
+  auto& costs = edge->second;
+  auto cost = costs.find(w);
+  if (cost == costs.end()) {
+    return false;
+  }
+
+  // w may refer to the weight being erased, so everything that reads it comes first
+  // only the smallest weight between two nodes is used by paths
+  const bool cheapest = !path_cache_.entries.empty() && cost == costs.begin();
+  content_hash_ -= EdgeHash(src, dest, w);
+  UnindexWeight(w, src_itr->get(), dst_itr->get());
+  Record(Mutation::kErase, src, dest, w);
+
+  costs.erase(cost);
+  // drop dest once no weights are left so it no longer counts as connected
+  const bool last = costs.empty();
+  if (last) {
+    edges.erase(edge);
+  }
+
+  if (cheapest) {
+    ForgetPathsWhere([&src, &dest](const typename PathCache::Entry& entry) {
+      return std::any_of(entry.second.begin(), entry.second.end(), [&](const Path& path) {
+        for (std::size_t i = 0; i + 1 < path.nodes.size(); ++i) {
+          if (!(path.nodes[i] < src) && !(src < path.nodes[i]) &&
+              !(path.nodes[i + 1] < dest) && !(dest < path.nodes[i + 1])) {
+            return true;
+          }
+        }
+        return false;
+      });
+    });
+  }
+
+  NoteSharedChange();
+  --edge_count_;
+  --src_itr->get()->out_degree_;
+  --dst_itr->get()->in_degree_;
+  // the last weight between two nodes may have been all that joined their components
+  if (components_.enabled && last) {
+    components_.stale = true;
+  }
+  return true;
+}
+
+/*
+    Gets a 64 bit hash of the nodes and edges which is the same for equal graphs
+    O(1) as it is updated by every mutation, except for graphs sharing nodes with a copy
+    which can be changed through the copy and so are hashed in full
+*/
+template <typename N, typename E>
+std::uint64_t gdwg::Graph<N, E>::ContentHash() const {
+  static_assert(IsHashable<N>::value && IsHashable<E>::value,
+                "Graph::ContentHash needs std::hash for the node and weight types");
+  return Aliased() ? HashContent() : content_hash_;
+}
+
+/*
+    Compares the node containers then each node's edges side by side
+    graphs sharing nodes with a copy may be out of order so their edges are sorted first
+*/
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::Equals(const Graph<N, E>& g) const {
+  if (nodes_.size() != g.nodes_.size()) {
+    return false;
+  }
+  if constexpr (IsHashable<N>::value && IsHashable<E>::value) {
+    if (!Aliased() && !g.Aliased() && content_hash_ != g.content_hash_) {
+      return false;
+    }
+  }
+
+  if (Aliased() || g.Aliased()) {
+    auto edges = [](const Graph<N, E>& graph) {
+      std::vector<std::tuple<N, N, E>> v;
+      graph.ForEachEdge(
+          [&v](const N& src, const N& dest, const E& w) { v.emplace_back(src, dest, w); });
+      std::sort(v.begin(), v.end());
+      return v;
+    };
+    return GetNodes() == g.GetNodes() && edges(*this) == edges(g);
+  }
+
+  auto skip_invalid = [](auto it, auto end) {
+    while (it != end && it->first.expired()) {
+      ++it;
+    }
+    return it;
+  };
+
+  for (auto it1 = nodes_.begin(), it2 = g.nodes_.begin(); it1 != nodes_.end(); ++it1, ++it2) {
+    const Node& n1 = **it1;
+    const Node& n2 = **it2;
+    if (!(n1.value_ == n2.value_)) {
+      return false;
+    }
+
+    auto e1 = skip_invalid(n1.edges_out_.begin(), n1.edges_out_.end());
+    auto e2 = skip_invalid(n2.edges_out_.begin(), n2.edges_out_.end());
+    while (e1 != n1.edges_out_.end() && e2 != n2.edges_out_.end()) {
+      if (!(e1->first.lock()->value_ == e2->first.lock()->value_) || e1->second != e2->second) {
+        return false;
+      }
+      e1 = skip_invalid(std::next(e1), n1.edges_out_.end());
+      e2 = skip_invalid(std::next(e2), n2.edges_out_.end());
+    }
+    if (e1 != n1.edges_out_.end() || e2 != n2.edges_out_.end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+    Hashes of a single node and a single edge, summed to give the content hash
+    zero when the node or weight type has no std::hash
+*/
+template <typename N, typename E>
+std::uint64_t gdwg::Graph<N, E>::NodeHash(const N& n) {
+  if constexpr (IsHashable<N>::value && IsHashable<E>::value) {
+    return Mix(std::hash<N>{}(n) + 0x9e3779b97f4a7c15ULL);
+  } else {
+    return 0;
+  }
+}
+
+template <typename N, typename E>
+std::uint64_t gdwg::Graph<N, E>::EdgeHash(const N& src, const N& dest, const E& w) {
+  if constexpr (IsHashable<N>::value && IsHashable<E>::value) {
+    auto h = Mix(std::hash<N>{}(src) + 0xc2b2ae3d27d4eb4fULL);
+    h = Mix(h ^ std::hash<N>{}(dest));
+    return Mix(h ^ std::hash<E>{}(w));
+  } else {
+    return 0;
+  }
+}
+
+/*
+    splitmix64 finaliser
+*/
+template <typename N, typename E>
+std::uint64_t gdwg::Graph<N, E>::Mix(std::uint64_t h) {
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return h ^ (h >> 31);
+}
+
+template <typename N, typename E>
+std::uint64_t gdwg::Graph<N, E>::HashContent() const {
+  std::uint64_t h = 0;
+  for (const auto& node : nodes_) {
+    h += NodeHash(node->value_);
+  }
+  ForEachEdge([&h](const N& src, const N& dest, const E& w) { h += EdgeHash(src, dest, w); });
+  return h;
+}
+
+/*
+    Starts recording every successful mutation in delta format
+    with a capacity in bytes, the oldest records are dropped to keep the journal within it
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::EnableJournal(std::size_t capacity_bytes) {
+  static_assert(IsSerializable<N>::value && IsSerializable<E>::value,
+                "Graph::EnableJournal requires a Serializer for nodes and weights");
+  journal_.enabled = true;
+  journal_.capacity = capacity_bytes;
+  while (journal_.capacity != 0 && journal_.bytes > journal_.capacity) {
+    journal_.bytes -= journal_.records.front().size();
+    journal_.records.pop_front();
+    ++journal_.first;
+  }
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::DisableJournal() {
+  journal_.first += journal_.records.size();
+  journal_.records.clear();
+  journal_.bytes = 0;
+  journal_.enabled = false;
+}
+
+/*
+    Drops the records and skips a sequence number, so Delta throws for every sequence number
+    handed out before and readers know to copy the graph again
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::RestartJournal() noexcept {
+  journal_.first += journal_.records.size() + 1;
+  journal_.records.clear();
+  journal_.bytes = 0;
+}
+
+/*
+    Gets the sequence number the next recorded mutation will have
+*/
+template <typename N, typename E>
+std::uint64_t gdwg::Graph<N, E>::JournalSequence() const {
+  return journal_.first + journal_.records.size();
+}
+
+/*
+    Gets the records from sequence number since onwards, ready for ApplyDelta
+*/
+template <typename N, typename E>
+std::string gdwg::Graph<N, E>::Delta(std::uint64_t since) const {
+  static_assert(IsSerializable<N>::value && IsSerializable<E>::value,
+                "Graph::Delta requires a Serializer for nodes and weights");
+  if (since < journal_.first || since > JournalSequence()) {
+    throw std::out_of_range("Cannot call Graph::Delta for records not held in the journal");
+  }
+
+  std::string delta;
+  for (auto it = journal_.records.begin() + (since - journal_.first); it != journal_.records.end();
+       ++it) {
+    delta.append(*it);
+  }
+  return delta;
+}
+
+/*
+    Replays a delta recorded by another graph's journal onto this graph
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::ApplyDelta(const std::string& delta) {
+  static_assert(IsSerializable<N>::value && IsSerializable<E>::value,
+                "Graph::ApplyDelta requires a Serializer for nodes and weights");
+  std::size_t pos = 0;
+  while (pos < delta.size()) {
+    auto op = static_cast<Mutation>(delta[pos++]);
+    switch (op) {
+      case Mutation::kInsertNode: {
+        InsertNode(Serializer<N>::Read(delta, pos));
+        break;
+      }
+      case Mutation::kInsertEdge:
+      case Mutation::kErase: {
+        N src = Serializer<N>::Read(delta, pos);
+        N dest = Serializer<N>::Read(delta, pos);
+        E w = Serializer<E>::Read(delta, pos);
+        if (op == Mutation::kInsertEdge) {
+          InsertEdge(src, dest, w);
+        } else {
+          erase(src, dest, w);
+        }
+        break;
+      }
+      case Mutation::kDeleteNode: {
+        DeleteNode(Serializer<N>::Read(delta, pos));
+        break;
+      }
+      case Mutation::kReplace:
+      case Mutation::kMergeReplace: {
+        N old_data = Serializer<N>::Read(delta, pos);
+        N new_data = Serializer<N>::Read(delta, pos);
+        if (op == Mutation::kReplace) {
+          Replace(old_data, new_data);
+        } else {
+          MergeReplace(old_data, new_data);
+        }
+        break;
+      }
+      case Mutation::kClear: {
+        Clear();
+        break;
+      }
+      default:
+        throw std::runtime_error("Cannot call Graph::ApplyDelta on a malformed delta");
+    }
+  }
+}
+
+template <typename N, typename E>
+template <typename... Args>
+void gdwg::Graph<N, E>::Record(Mutation op, const Args&... args) {
+  if (!journal_.enabled) {
+    return;
+  }
+
+  // the journal can only be enabled for serializable types, so this is never reached without
+  // a Serializer, but it must still compile for every node and weight type
+  if constexpr ((IsSerializable<Args>::value && ...)) {
+    std::string record(1, static_cast<char>(op));
+    (Serializer<Args>::Write(record, args), ...);
+
+    journal_.bytes += record.size();
+    journal_.records.push_back(std::move(record));
+
+    // always keep the newest record, even when it alone is over capacity
+    while (journal_.capacity != 0 && journal_.bytes > journal_.capacity &&
+           journal_.records.size() > 1) {
+      journal_.bytes -= journal_.records.front().size();
+      journal_.records.pop_front();
+      ++journal_.first;
+    }
+  }
+}
+
+/*
+    Starts keeping the weakly connected components, built once here and then updated by
+    every insertion in near constant time
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::EnableComponentTracking() {
+  components_.enabled = true;
+  RebuildComponents();
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::DisableComponentTracking() {
+  components_ = Components{};
+}
+
+/*
+    Checks whether a path joins a and b when edge directions are ignored
+*/
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::SameComponent(const N& a, const N& b) const {
+  if (!components_.enabled) {
+    throw std::runtime_error(
+        "Cannot call Graph::SameComponent without component tracking enabled");
+  }
+  auto a_it = FindNode(a);
+  auto b_it = FindNode(b);
+  if (a_it == nodes_.end() || b_it == nodes_.end()) {
+    throw std::out_of_range(
+        "Cannot call Graph::SameComponent if a or b node don't exist in the graph");
+  }
+
+  // a copy sharing these nodes can change their edges without telling this graph
+  const bool aliased = Aliased();
+  std::lock_guard<std::mutex> lock{components_mutex_};
+  if (components_.stale || aliased) {
+    RebuildComponents();
+  }
+  return FindRoot(components_.index.at(a_it->get())) ==
+         FindRoot(components_.index.at(b_it->get()));
+}
+
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::ComponentCount() const {
+  if (!components_.enabled) {
+    throw std::runtime_error(
+        "Cannot call Graph::ComponentCount without component tracking enabled");
+  }
+
+  const bool aliased = Aliased();
+  std::lock_guard<std::mutex> lock{components_mutex_};
+  if (components_.stale || aliased) {
+    RebuildComponents();
+  }
+  return components_.count;
+}
+
+/*
+    Adds node to the components as a set of its own
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::TrackNode(const Node* node) const {
+  if (!components_.enabled || components_.stale) {
+    return;
+  }
+
+  auto slot = components_.parent.size();
+  components_.index.emplace(node, slot);
+  components_.parent.push_back(slot);
+  components_.size.push_back(1);
+  ++components_.count;
+}
+
+/*
+    Joins the sets holding a and b, the smaller under the larger
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::UniteNodes(const Node* a, const Node* b) const {
+  if (!components_.enabled || components_.stale) {
+    return;
+  }
+
+  auto a_slot = components_.index.find(a);
+  auto b_slot = components_.index.find(b);
+  if (a_slot == components_.index.end() || b_slot == components_.index.end()) {
+    return;
+  }
+
+  auto a_root = FindRoot(a_slot->second);
+  auto b_root = FindRoot(b_slot->second);
+  if (a_root == b_root) {
+    return;
+  }
+  if (components_.size[a_root] < components_.size[b_root]) {
+    std::swap(a_root, b_root);
+  }
+  components_.parent[b_root] = a_root;
+  components_.size[a_root] += components_.size[b_root];
+  --components_.count;
+}
+
+/*
+    Finds the root of slot's set, halving the path to it on the way
+*/
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::FindRoot(std::size_t slot) const {
+  auto& parent = components_.parent;
+  while (parent[slot] != slot) {
+    parent[slot] = parent[parent[slot]];
+    slot = parent[slot];
+  }
+  return slot;
+}
+
+/*
+    Rebuilds the components from the nodes and edges in O(V + E)
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::RebuildComponents() const {
+  components_ = Components{};
+  components_.enabled = true;
+  components_.index.reserve(nodes_.size());
+  for (const auto& node : nodes_) {
+    TrackNode(node.get());
+  }
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest || costs.empty()) {
+        continue;
+      }
+      if (components_.index.count(dest.get()) > 0) {
+        UniteNodes(node.get(), dest.get());
+      } else if (const Node* same = ResolveNode(dest.get())) {
+        UniteNodes(node.get(), same);
+      }
+    }
+  }
+}
+
+/*
+    Starts keeping every weight in (weight, src, dst) order, built once here in
+    O(E log E) and then updated by every mutation in O(log E) per weight
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::EnableWeightIndex() {
+  weight_index_.enabled = true;
+  RebuildWeightIndex();
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::DisableWeightIndex() {
+  weight_index_ = WeightIndex{};
+}
+
+/*
+    Checks whether mutations should be applied to the weight index
+    a copy sharing these nodes can rename them without telling this graph, leaving the
+    index out of order, so it is rebuilt by each query instead
+*/
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::IndexingWeights() const {
+  return weight_index_.enabled && !weight_index_.stale && !Aliased();
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::IndexWeight(E weight, const Node* src, const Node* dst) {
+  if (IndexingWeights()) {
+    weight_index_.entries.insert(WeightEntry{std::move(weight), src, dst});
+  }
+}
+
+template <typename N, typename E>
+void gdwg::Graph<N, E>::UnindexWeight(const E& weight, const Node* src, const Node* dst) {
+  if (IndexingWeights()) {
+    weight_index_.entries.erase(WeightEntry{weight, src, dst});
+  }
+}
+
+/*
+    Rebuilds the weight index from every edge in O(E log E)
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::RebuildWeightIndex() const {
+  weight_index_.entries.clear();
+  weight_index_.stale = false;
+  for (const auto& node : nodes_) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      if (std::shared_ptr<Node> dest = edge_to.lock()) {
+        for (const auto& cost : costs) {
+          weight_index_.entries.insert(WeightEntry{cost, node.get(), dest.get()});
+        }
+      }
+    }
+  }
+}
+
+/*
+    Answers IsConnected for every (src, dst) pair, results in query order
+    queries are grouped by source so each source is looked up once and its edges walked once
+*/
+template <typename N, typename E>
+std::vector<bool> gdwg::Graph<N, E>::IsConnectedBatch(const std::vector<std::pair<N, N>>& queries,
+                                                      unsigned int num_threads) const {
+  std::vector<char> connected(queries.size(), 0);
+  ResolveBatch(queries, num_threads,
+               [&connected](std::size_t i, const WeightSet* costs) {
+                 connected[i] = costs != nullptr;
+               },
+               []() {
+                 throw std::runtime_error("Cannot call Graph::IsConnectedBatch if src or dst node "
+                                          "don't exist in the graph");
+               });
+
+  return std::vector<bool>(connected.begin(), connected.end());
+}
+
+/*
+    Answers GetWeights for every (src, dst) pair into one flat array
+*/
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::WeightsBatch
+gdwg::Graph<N, E>::GetWeightsBatch(const std::vector<std::pair<N, N>>& queries,
+                                   unsigned int num_threads) const {
+  std::vector<const WeightSet*> found(queries.size(), nullptr);
+  ResolveBatch(queries, num_threads,
+               [&found](std::size_t i, const WeightSet* costs) {
+                 found[i] = costs;
+               },
+               []() {
+                 throw std::out_of_range("Cannot call Graph::GetWeightsBatch if src or dst node "
+                                         "don't exist in the graph");
+               });
+
+  WeightsBatch batch;
+  batch.offsets.reserve(queries.size() + 1);
+  batch.offsets.push_back(0);
+  for (const auto* costs : found) {
+    batch.offsets.push_back(batch.offsets.back() + (costs ? costs->size() : 0));
+  }
+
+  batch.weights.reserve(batch.offsets.back());
+  for (const auto* costs : found) {
+    if (costs) {
+      batch.weights.insert(batch.weights.end(), costs->begin(), costs->end());
+    }
+  }
+  return batch;
+}
+
+/*
+    Sorts the queries by (src, dst) and merges each source's queries with its ordered edges
+    calls found(query index, weights or nullptr) for each query, or missing() when a node
+    does not exist, sources are shared out across num_threads threads
+*/
+template <typename N, typename E>
+template <typename F, typename M>
+void gdwg::Graph<N, E>::ResolveBatch(const std::vector<std::pair<N, N>>& queries,
+                                     unsigned int num_threads,
+                                     F found,
+                                     M missing) const {
+  std::vector<std::size_t> order(queries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&queries](std::size_t a, std::size_t b) { return queries[a] < queries[b]; });
+
+  std::vector<std::size_t> groups;
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    if (i == 0 || queries[order[i]].first != queries[order[i - 1]].first) {
+      groups.push_back(i);
+    }
+  }
+  groups.push_back(order.size());
+
+  RunChunks(groups.size() - 1, num_threads, [&](std::size_t first, std::size_t last) {
+    for (auto group = first; group < last; ++group) {
+      auto src_it = FindNode(queries[order[groups[group]]].first);
+      if (src_it == nodes_.end()) {
+        missing();
+      }
+
+      const auto& edges = src_it->get()->edges_out_;
+      auto edge = edges.begin();
+      for (auto i = groups[group]; i < groups[group + 1]; ++i) {
+        const N& dest = queries[order[i]].second;
+
+        const WeightSet* costs = nullptr;
+        for (; edge != edges.end(); ++edge) {
+          std::shared_ptr<Node> to = edge->first.lock();
+          if (to && !(to->value_ < dest)) {
+            costs = to->value_ == dest ? &edge->second : nullptr;
+            break;
+          }
+        }
+
+        if (costs == nullptr) {
+          auto exact = Node::FindEdgeIn(edges, dest, Aliased());
+          if (exact != edges.end()) {
+            costs = &exact->second;
+          } else if (!IsNode(dest)) {
+            missing();
+          }
+        }
+
+        found(order[i], costs);
+      }
+    }
+  });
+}
+
+/*
+    Checks whether the nodes are shared with a copy, or were changed through one since this
+    graph's counts, hash and indexes were last made to agree with them
+    a copy that no longer exists can no longer change the nodes, so they are made to agree
+    once here and the fast paths are used again
+*/
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::Aliased() const {
+  if (sharing_.use_count() > 1) {
+    return true;
+  }
+  const auto changes = sharing_->changes.load(std::memory_order_acquire);
+  return synced_.load(std::memory_order_acquire) != changes && !Resync(changes);
+}
+
+/*
+    Rebuilds everything a change through a copy could have left out of date in O(V + E)
+    false when a rename through a copy left nodes_ out of order, in which case lookups
+    keep falling back to a linear scan until the graph is cleared or assigned to
+*/
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::Resync(std::uint64_t changes) const {
+  std::lock_guard<std::mutex> lock{sharing_mutex_};
+  const auto synced = synced_.load(std::memory_order_relaxed);
+  if (synced == changes || synced == kUnordered) {
+    return synced == changes;
+  }
+
+  auto by_value = [](const std::shared_ptr<Node>& lhs, const std::shared_ptr<Node>& rhs) {
+    return !(lhs->value_ < rhs->value_);
+  };
+  if (std::adjacent_find(nodes_.begin(), nodes_.end(), by_value) != nodes_.end()) {
+    synced_.store(kUnordered, std::memory_order_release);
+    return false;
+  }
+
+  for (const auto& node : nodes_) {
+    PurgeExpiredEdges(*node);
+  }
+  RebuildIndexes();
+  {
+    std::lock_guard<std::mutex> topo_lock{topo_mutex_};
+    topo_ = TopologicalState{};
+  }
+  {
+    std::lock_guard<std::mutex> paths_lock{path_cache_mutex_};
+    ForgetPaths();
+  }
+  {
+    std::lock_guard<std::mutex> components_lock{components_mutex_};
+    components_.stale = true;
+  }
+  {
+    std::lock_guard<std::mutex> index_lock{weight_index_mutex_};
+    weight_index_.stale = true;
+  }
+  synced_.store(changes, std::memory_order_release);
+  return true;
+}
+
+/*
+    Tells the other graphs sharing these nodes that one of them changed
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::NoteSharedChange() {
+  if (sharing_.use_count() > 1) {
+    sharing_->changes.fetch_add(1, std::memory_order_release);
+  }
+}
+
+/*
+    Finds the node holding val in O(log V)
+*/
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::NodeItr gdwg::Graph<N, E>::FindNode(const N& val) const {
+  auto it = nodes_.find(val);
+  if (it != nodes_.end() || !Aliased()) {
+    return it;
+  }
+
+  return std::find_if(nodes_.begin(), nodes_.end(),
+                      [&val](std::shared_ptr<Node> const& n) { return n->value_ == val; });
+}
+
+/*
+    Gets the node of this graph holding the same value as dest, or null if there is none
+    dest is only missing from this graph when a copy sharing these nodes dropped a node
+    and added another with the same value, and edges to it are matched by value like
+    iteration and every lookup
+*/
+template <typename N, typename E>
+const typename gdwg::Graph<N, E>::Node* gdwg::Graph<N, E>::ResolveNode(const Node* dest) const {
+  auto it = nodes_.find(dest->value_);
+  if (it == nodes_.end() || !((*it)->value_ == dest->value_)) {
+    it = std::find_if(nodes_.begin(), nodes_.end(), [dest](const std::shared_ptr<Node>& n) {
+      return n->value_ == dest->value_;
+    });
+  }
+  return it == nodes_.end() ? nullptr : it->get();
+}
+
+/*
+    Erases the edges to nodes no graph holds any more, which a node dropped while it was
+    shared with a copy leaves behind, and which compare equal to every other edge
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::PurgeExpiredEdges(Node& node) {
+  for (auto it = node.edges_out_.begin(); it != node.edges_out_.end();) {
+    it = it->first.expired() ? node.edges_out_.erase(it) : std::next(it);
+  }
+}
+
+/*
+    Removes a node and the edges other nodes have to it
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::DropNode(NodeItr it) {
+  const Node* dropped = it->get();
+  NoteSharedChange();
+  ForgetNode(dropped);
+  ForgetPathsWhere([dropped](const typename PathCache::Entry& entry) {
+    auto same = [dropped](const N& n) {
+      return !(n < dropped->value_) && !(dropped->value_ < n);
+    };
+    const auto& [src, dst, k] = entry.first;
+    return same(src) || same(dst) || std::any_of(
+        entry.second.begin(), entry.second.end(), [&same](const Path& path) {
+          return std::any_of(path.nodes.begin(), path.nodes.end(), same);
+        });
+  });
+
+  content_hash_ -= NodeHash(dropped->value_);
+  for (const auto& [edge_to, costs] : dropped->edges_out_) {
+    if (std::shared_ptr<Node> dest = edge_to.lock()) {
+      edge_count_ -= costs.size();
+      dest->in_degree_ -= costs.size();
+      for (const auto& cost : costs) {
+        content_hash_ -= EdgeHash(dropped->value_, dest->value_, cost);
+        UnindexWeight(cost, dropped, dest.get());
+      }
+    }
+  }
+
+  // a copy sharing these nodes may still hold the dropped node and its incoming edges
+  if (!Aliased()) {
+    for (const auto& node : nodes_) {
+      auto edge = Node::FindEdgeIn(node->edges_out_, dropped->value_, false);
+      if (node.get() == dropped || edge == node->edges_out_.end() ||
+          edge->first.lock().get() != dropped) {
+        continue;
+      }
+
+      edge_count_ -= edge->second.size();
+      node->out_degree_ -= edge->second.size();
+      for (const auto& cost : edge->second) {
+        content_hash_ -= EdgeHash(node->value_, dropped->value_, cost);
+        UnindexWeight(cost, node.get(), dropped);
+      }
+      node->edges_out_.erase(edge);
+    }
+  }
+
+  nodes_.erase(it);
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator
+gdwg::Graph<N, E>::find(const N& src, const N& dest, const E& cost) const {
+  auto from = FindNode(src);
+  if (from == nodes_.end()) {
+    return cend();
+  }
+
+  auto& edges = from->get()->edges_out_;
+  auto to = Node::FindEdgeIn(edges, dest, Aliased());
+  if (to == edges.end() || to->first.expired()) {
+    return cend();
+  }
+
+  auto weight = to->second.find(cost);
+  if (weight == to->second.end()) {
+    return cend();
+  }
+  return {from, nodes_.begin(), nodes_.end(),
+          to, edges.begin(), edges.end(),
+          weight, to->second.begin(), to->second.end()};
+}
+
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::erase(const_iterator it) {
+  if (it == cend()) {
+    return cend();
+  }
+
+  std::tuple<N, N, E> edge = *it;
+  auto itr = it;
+  if (++itr == cend()) {
+    erase(std::get<0>(edge), std::get<1>(edge), std::get<2>(edge));
+    return cend();
+  }
+
+  // erasing can shift the weights stored after it, so find the next edge again
+  std::tuple<N, N, E> next = *itr;
+  erase(std::get<0>(edge), std::get<1>(edge), std::get<2>(edge));
+  return find(std::get<0>(next), std::get<1>(next), std::get<2>(next));
+}
+
+/*
+    Calls fn(src, dest, weight) for every edge in iterator order
+    walks the node and edge containers directly instead of building iterator tuples
+*/
+template <typename N, typename E>
+template <typename F>
+void gdwg::Graph<N, E>::ForEachEdge(F fn) const {
+  ForEachEdgeIn(nodes_.cbegin(), nodes_.cend(), fn);
+}
+
+/*
+    Calls fn(src, dest, weight) for every edge from several threads at once
+    source nodes are split into ranges holding roughly the same number of edges
+    fn is shared by every thread and must be safe to call concurrently, edges within a
+    range are visited in order
+*/
+template <typename N, typename E>
+template <typename F>
+void gdwg::Graph<N, E>::ParallelForEachEdge(F&& fn, unsigned int num_threads) const {
+  RunPartitioned(num_threads, [&fn](std::size_t, NodeItr first, NodeItr last) {
+    ForEachEdgeIn(first, last, fn);
+  }, [](std::size_t) {});
+}
+
+/*
+    Parallel reduction over every edge
+    each thread folds its range into a value initialised T with fn(acc, src, dest, weight)
+    and the partial results are merged into init in source order with acc = combine(acc, partial)
+    so init is counted once whatever the number of threads
+*/
+template <typename N, typename E>
+template <typename T, typename F, typename R>
+T gdwg::Graph<N, E>::ParallelReduceEdges(T init, F fn, R combine, unsigned int num_threads) const {
+  std::vector<T> partials;
+  RunPartitioned(num_threads, [&](std::size_t part, NodeItr first, NodeItr last) {
+    auto visit = [&partials, &fn, part](const N& src, const N& dest, const E& w) {
+      fn(partials[part], src, dest, w);
+    };
+    ForEachEdgeIn(first, last, visit);
+  }, [&partials](std::size_t parts) { partials.assign(parts, T{}); });
+
+  T result = std::move(init);
+  for (auto& partial : partials) {
+    result = combine(std::move(result), std::move(partial));
+  }
+  return result;
+}
+
+template <typename N, typename E>
+template <typename F>
+void gdwg::Graph<N, E>::ForEachEdgeIn(NodeItr first, NodeItr last, F& fn) {
+  for (auto it = first; it != last; ++it) {
+    const auto& src = (*it)->value_;
+    for (const auto& [edge_to, costs] : (*it)->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest) {
+        continue;
+      }
+      for (const auto& cost : costs) {
+        fn(src, dest->value_, cost);
+      }
+    }
+  }
+}
+
+/*
+    Splits the source nodes into at most parts contiguous ranges
+    balanced by the number of edges in each range rather than the number of nodes
+*/
+template <typename N, typename E>
+std::vector<std::pair<typename gdwg::Graph<N, E>::NodeItr, typename gdwg::Graph<N, E>::NodeItr>>
+gdwg::Graph<N, E>::PartitionByEdges(unsigned int parts) const {
+  std::vector<std::size_t> counts;
+  counts.reserve(nodes_.size());
+  std::size_t total = 0;
+  const bool aliased = Aliased();
+  for (const auto& node : nodes_) {
+    std::size_t count = aliased ? CountOut(*node) : node->out_degree_;
+    counts.push_back(count);
+    total += count;
+  }
+
+  if (parts == 0 || total < parts) {
+    parts = std::max<std::size_t>(total, 1);
+  }
+
+  std::vector<std::pair<NodeItr, NodeItr>> ranges;
+  ranges.reserve(parts);
+  NodeItr first = nodes_.cbegin();
+  std::size_t seen = 0;
+  std::size_t i = 0;
+  for (auto it = nodes_.cbegin(); it != nodes_.cend() && ranges.size() + 1 < parts; ++it, ++i) {
+    seen += counts[i];
+    if (seen * parts >= total * (ranges.size() + 1)) {
+      ranges.emplace_back(first, std::next(it));
+      first = std::next(it);
+    }
+  }
+  ranges.emplace_back(first, nodes_.cend());
+
+  return ranges;
+}
+
+/*
+    Runs body(part, first, last) for each edge balanced range, one range per thread
+    setup(number of ranges) is called first so callers can size per range state
+*/
+template <typename N, typename E>
+template <typename F, typename S>
+void gdwg::Graph<N, E>::RunPartitioned(unsigned int num_threads, F body, S setup) const {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  auto ranges = PartitionByEdges(num_threads);
+  setup(ranges.size());
+
+  RunChunks(ranges.size(), ranges.size(), [&body, &ranges](std::size_t first, std::size_t last) {
+    for (auto part = first; part < last; ++part) {
+      body(part, ranges[part].first, ranges[part].second);
+    }
+  });
+}
+
+/*
+    Splits [0, count) into one contiguous chunk per thread and runs body(first, last) on each
+    the calling thread takes the first chunk, exceptions are rethrown after all threads join
+*/
+template <typename N, typename E>
+template <typename F>
+void gdwg::Graph<N, E>::RunChunks(std::size_t count, unsigned int num_threads, F body) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  const std::size_t chunks = std::min<std::size_t>(num_threads, count);
+  if (chunks <= 1) {
+    body(0, count);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(chunks);
+  auto run = [&body, &errors, count, chunks](std::size_t chunk) {
+    try {
+      body(count * chunk / chunks, count * (chunk + 1) / chunks);
+    } catch (...) {
+      errors[chunk] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(chunks - 1);
+  for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+    workers.emplace_back(run, chunk);
+  }
+  run(0);
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+/*
+    Gets the nodes ordered so every edge goes from an earlier node to a later one
+    the order is kept up to date by InsertNode, InsertEdge, DeleteNode and MergeReplace
+    once computed, so repeated calls only copy it out
+    graphs sharing nodes with a copy, which can add edges without telling this graph,
+    sort from scratch on every call
+*/
+template <typename N, typename E>
+std::vector<N> gdwg::Graph<N, E>::TopologicalOrder() const {
+  std::vector<N> v;
+  auto copy_out = [&v](const std::vector<const Node*>& order) {
+    v.reserve(order.size());
+    for (const auto* node : order) {
+      if (node != nullptr) {
+        v.push_back(node->value_);
+      }
+    }
+  };
+
+  bool acyclic;
+  if (Aliased()) {
+    std::vector<const Node*> order;
+    std::vector<const Node*> cycle;
+    acyclic = SortTopologically(order, cycle);
+    copy_out(order);
+  } else {
+    std::lock_guard<std::mutex> lock{topo_mutex_};
+    acyclic = CacheTopologicalOrder();
+    copy_out(topo_.order);
+  }
+
+  if (!acyclic) {
+    throw std::runtime_error("Cannot call Graph::TopologicalOrder on a graph with a cycle");
+  }
+  return v;
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::IsAcyclic() const {
+  if (Aliased()) {
+    std::vector<const Node*> order;
+    std::vector<const Node*> cycle;
+    return SortTopologically(order, cycle);
+  }
+
+  std::lock_guard<std::mutex> lock{topo_mutex_};
+  return CacheTopologicalOrder();
+}
+
+/*
+    Sorts the nodes into topo_ unless the order there is still valid, false on a cycle
+    callers hold topo_mutex_
+*/
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::CacheTopologicalOrder() const {
+  if (topo_.valid) {
+    return true;
+  }
+
+  std::vector<const Node*> order;
+  std::vector<const Node*> cycle;
+  if (!SortTopologically(order, cycle)) {
+    return false;
+  }
+
+  topo_ = TopologicalState{};
+  topo_.position.reserve(order.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    topo_.position.emplace(order[i], i);
+  }
+  topo_.order = std::move(order);
+  topo_.valid = true;
+  return true;
+}
+
+/*
+    Gets the nodes of a cycle in edge order (the last node has an edge back to the first)
+    or an empty vector when the graph is acyclic
+*/
+template <typename N, typename E>
+std::vector<N> gdwg::Graph<N, E>::FindCycle() const {
+  std::vector<N> v;
+  if (!Aliased()) {
+    std::lock_guard<std::mutex> lock{topo_mutex_};
+    if (topo_.valid) {
+      return v;
+    }
+  }
+
+  std::vector<const Node*> order;
+  std::vector<const Node*> cycle;
+  SortTopologically(order, cycle);
+
+  v.reserve(cycle.size());
+  for (const auto* node : cycle) {
+    v.push_back(node->value_);
+  }
+  return v;
+}
+
+/*
+    Adds an edge between two nodes of this graph and keeps the topological order in step
+*/
+template <typename N, typename E>
+template <typename W>
+bool gdwg::Graph<N, E>::LinkNodes(const std::shared_ptr<Node>& src,
+                                  const std::shared_ptr<Node>& dest,
+                                  W&& w) {
+  // w may be moved into the graph, so everything that reads it comes first
+  const std::uint64_t hash = EdgeHash(src->value_, dest->value_, w);
+  std::optional<E> indexed;
+  if (IndexingWeights()) {
+    indexed.emplace(w);
+  }
+  // a new edge or a cheaper weight on an existing one can shorten the paths through it
+  std::optional<E> cheapest;
+  if (!path_cache_.entries.empty()) {
+    auto edge = Node::FindEdgeIn(src->edges_out_, dest->value_, false);
+    if (edge == src->edges_out_.end() || edge->second.empty() || w < *edge->second.begin()) {
+      cheapest.emplace(w);
+    }
+  }
+
+  if (!src->AddEdgeTo(dest, std::forward<W>(w), Aliased())) {
+    return false;
+  }
+
+  ++edge_count_;
+  ++src->out_degree_;
+  ++dest->in_degree_;
+  content_hash_ += hash;
+  NoteSharedChange();
+  if (topo_.valid) {
+    ReorderAfterInsert(src.get(), dest.get());
+  }
+  UniteNodes(src.get(), dest.get());
+  if (indexed) {
+    IndexWeight(std::move(*indexed), src.get(), dest.get());
+  }
+  if (cheapest) {
+    ForgetPathsThrough(src.get(), dest.get(), *cheapest);
+  }
+  return true;
+}
+
+/*
+    Iterative depth first search over the whole graph in O(V + E)
+    fills order with the reverse postorder, or cycle with the nodes on the
+    first back edge found and returns false
+*/
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::SortTopologically(std::vector<const Node*>& order,
+                                          std::vector<const Node*>& cycle) const {
+  enum class Colour { kWhite, kGrey, kBlack };
+  using EdgeItr = typename std::map<std::weak_ptr<Node>, WeightSet,
+                                    CompareByValue<Node>>::const_iterator;
+
+  std::unordered_map<const Node*, Colour> colour;
+  colour.reserve(nodes_.size());
+  for (const auto& node : nodes_) {
+    colour.emplace(node.get(), Colour::kWhite);
+  }
+
+  order.clear();
+  order.reserve(nodes_.size());
+  std::vector<std::pair<const Node*, EdgeItr>> stack;
+
+  for (const auto& root : nodes_) {
+    if (colour[root.get()] != Colour::kWhite) {
+      continue;
+    }
+
+    colour[root.get()] = Colour::kGrey;
+    stack.emplace_back(root.get(), root->edges_out_.begin());
+
+    while (!stack.empty()) {
+      const Node* current = stack.back().first;
+      EdgeItr& edge = stack.back().second;
+
+      if (edge == current->edges_out_.end()) {
+        colour[current] = Colour::kBlack;
+        order.push_back(current);
+        stack.pop_back();
+        continue;
+      }
+
+      const auto& [edge_to, costs] = *edge++;
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest || costs.empty()) {
+        continue;
+      }
+
+      auto found = colour.find(dest.get());
+      if (found == colour.end()) {
+        const Node* same = ResolveNode(dest.get());
+        found = same ? colour.find(same) : colour.end();
+      }
+      if (found == colour.end() || found->second == Colour::kBlack) {
+        continue;
+      }
+
+      // back edge closes a cycle through the nodes still on the stack
+      const Node* target = found->first;
+      if (found->second == Colour::kGrey) {
+        auto start = std::find_if(stack.begin(), stack.end(),
+                                  [target](const auto& frame) { return frame.first == target; });
+        cycle.clear();
+        for (auto it = start; it != stack.end(); ++it) {
+          cycle.push_back(it->first);
+        }
+        return false;
+      }
+
+      found->second = Colour::kGrey;
+      stack.emplace_back(target, target->edges_out_.begin());
+    }
+  }
+
+  std::reverse(order.begin(), order.end());
+  return true;
+}
+
+/*
+    Restores the topological order after adding src -> dest (Marchetti-Spaccamela et al.)
+    only nodes between dest and src in the current order are visited and moved
+    the order is dropped if the new edge closes a cycle
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::ReorderAfterInsert(const Node* src, const Node* dest) {
+  auto src_pos = topo_.position.find(src);
+  auto dest_pos = topo_.position.find(dest);
+  if (src_pos == topo_.position.end() || dest_pos == topo_.position.end() || src == dest) {
+    topo_ = TopologicalState{};
+    return;
+  }
+
+  const std::size_t lower = dest_pos->second;
+  const std::size_t upper = src_pos->second;
+  if (lower > upper) {
+    return;
+  }
+
+  // nodes reachable from dest that currently sit at or before src must move after it
+  std::unordered_set<const Node*> reached{dest};
+  std::vector<const Node*> stack{dest};
+  while (!stack.empty()) {
+    const Node* current = stack.back();
+    stack.pop_back();
+
+    for (const auto& [edge_to, costs] : current->edges_out_) {
+      std::shared_ptr<Node> next = edge_to.lock();
+      if (!next || costs.empty()) {
+        continue;
+      }
+      if (next.get() == src) {
+        topo_ = TopologicalState{};
+        return;
+      }
+
+      auto pos = topo_.position.find(next.get());
+      if (pos != topo_.position.end() && pos->second <= upper &&
+          reached.insert(next.get()).second) {
+        stack.push_back(next.get());
+      }
+    }
+  }
+
+  std::vector<const Node*> window;
+  window.reserve(upper - lower + 1);
+  for (std::size_t i = lower; i <= upper; ++i) {
+    if (reached.find(topo_.order[i]) == reached.end()) {
+      window.push_back(topo_.order[i]);
+    }
+  }
+  for (std::size_t i = lower; i <= upper; ++i) {
+    if (reached.find(topo_.order[i]) != reached.end()) {
+      window.push_back(topo_.order[i]);
+    }
+  }
+
+  for (std::size_t i = 0; i < window.size(); ++i) {
+    topo_.order[lower + i] = window[i];
+    if (window[i] != nullptr) {
+      topo_.position[window[i]] = lower + i;
+    }
+  }
+}
+
+/*
+    Removes a node about to be deleted from the topological order
+    leaves a hole which is compacted once half the order is holes
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::ForgetNode(const Node* node) {
+  auto pos = topo_.position.find(node);
+  if (pos == topo_.position.end()) {
+    return;
+  }
+
+  topo_.order[pos->second] = nullptr;
+  topo_.position.erase(pos);
+  ++topo_.holes;
+
+  if (topo_.holes * 2 > topo_.order.size()) {
+    topo_.order.erase(std::remove(topo_.order.begin(), topo_.order.end(), nullptr),
+                      topo_.order.end());
+    for (std::size_t i = 0; i < topo_.order.size(); ++i) {
+      topo_.position[topo_.order[i]] = i;
+    }
+    topo_.holes = 0;
+  }
+}
+
+/*
+    Gets the strongly connected components using an iterative Tarjan search in O(V + E)
+    components are ordered by their smallest node and hold their nodes in ascending order
+*/
+template <typename N, typename E>
+std::vector<std::vector<N>> gdwg::Graph<N, E>::StronglyConnectedComponents() const {
+  auto forward = BuildAdjacency();
+  const std::size_t n = forward.nodes.size();
+
+  std::vector<std::size_t> roots(n);
+  for (std::size_t v = 0; v < n; ++v) {
+    roots[v] = v;
+  }
+
+  std::vector<std::size_t> order_index(n, kNone);
+  std::vector<std::size_t> low(n, kNone);
+  std::vector<std::size_t> component(n, kNone);
+  std::size_t next_component = 0;
+  Tarjan(forward, roots, [](std::size_t) { return true; },
+         [&next_component]() { return next_component++; }, order_index, low, component);
+
+  return GroupComponents(forward, component);
+}
+
+/*
+    Gets the same components as StronglyConnectedComponents using the forward-backward algorithm
+    each task trims nodes with no predecessor or successor left in its set, then splits the rest
+    around a pivot into its component and three independent sets handed to the other threads
+    sets of at most kSequentialComponentCutoff nodes are finished with Tarjan
+*/
+template <typename N, typename E>
+std::vector<std::vector<N>>
+gdwg::Graph<N, E>::ParallelStronglyConnectedComponents(unsigned int num_threads) const {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  auto forward = BuildAdjacency();
+  auto backward = forward.Transpose();
+  const std::size_t n = forward.nodes.size();
+
+  // owner[v] is the id of the task holding v, ids are never reused so tasks only see their nodes
+  std::vector<std::atomic<std::size_t>> owner(n);
+  for (auto& o : owner) {
+    o.store(0, std::memory_order_relaxed);
+  }
+  std::vector<std::size_t> order_index(n, kNone);
+  std::vector<std::size_t> low(n, kNone);
+  std::vector<std::size_t> component(n, kNone);
+  std::vector<unsigned char> reached(n, 0);
+  std::atomic<std::size_t> next_task{1};
+  std::atomic<std::size_t> next_component{0};
+
+  using Task = std::pair<std::size_t, std::vector<std::size_t>>;
+
+  auto process = [&](Task task) {
+    const std::size_t id = task.first;
+    auto& members = task.second;
+    auto in_scope = [&owner, id](std::size_t v) {
+      return owner[v].load(std::memory_order_relaxed) == id;
+    };
+    auto take_component = [&next_component]() { return next_component++; };
+
+    std::vector<Task> split;
+    if (members.size() <= kSequentialComponentCutoff) {
+      Tarjan(forward, members, in_scope, take_component, order_index, low, component);
+      for (auto v : members) {
+        owner[v].store(kNone, std::memory_order_relaxed);
+      }
+      return split;
+    }
+
+    auto has_neighbour = [&in_scope](const Adjacency& adj, std::size_t v) {
+      for (std::size_t e = adj.offsets[v]; e < adj.offsets[v + 1]; ++e) {
+        if (in_scope(adj.targets[e])) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    std::vector<std::size_t> remaining;
+    remaining.reserve(members.size());
+    for (auto v : members) {
+      if (!has_neighbour(forward, v) || !has_neighbour(backward, v)) {
+        component[v] = take_component();
+        owner[v].store(kNone, std::memory_order_relaxed);
+      } else {
+        remaining.push_back(v);
+      }
+    }
+    if (remaining.empty()) {
+      return split;
+    }
+
+    auto search = [&](const Adjacency& adj, unsigned char bit) {
+      std::vector<std::size_t> queue{remaining.front()};
+      reached[remaining.front()] |= bit;
+      for (std::size_t head = 0; head < queue.size(); ++head) {
+        const std::size_t v = queue[head];
+        for (std::size_t e = adj.offsets[v]; e < adj.offsets[v + 1]; ++e) {
+          const std::size_t w = adj.targets[e];
+          if (in_scope(w) && !(reached[w] & bit)) {
+            reached[w] |= bit;
+            queue.push_back(w);
+          }
+        }
+      }
+    };
+    search(forward, 1);
+    search(backward, 2);
+
+    const std::size_t pivot_component = take_component();
+    const std::size_t first_id = next_task.fetch_add(3);
+    split = {{first_id, {}}, {first_id + 1, {}}, {first_id + 2, {}}};
+    for (auto v : remaining) {
+      if (reached[v] == 3) {
+        component[v] = pivot_component;
+        owner[v].store(kNone, std::memory_order_relaxed);
+      } else {
+        // 0: reached by neither search, 1: forward only, 2: backward only
+        split[reached[v]].second.push_back(v);
+        owner[v].store(first_id + reached[v], std::memory_order_relaxed);
+      }
+      reached[v] = 0;
+    }
+
+    split.erase(std::remove_if(split.begin(), split.end(),
+                               [](const Task& t) { return t.second.empty(); }),
+                split.end());
+    return split;
+  };
+
+  std::vector<std::size_t> all(n);
+  for (std::size_t v = 0; v < n; ++v) {
+    all[v] = v;
+  }
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<Task> tasks;
+  tasks.emplace_back(0, std::move(all));
+  std::size_t pending = 1;
+
+  auto work = [&]() {
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true) {
+      ready.wait(lock, [&]() { return !tasks.empty() || pending == 0; });
+      if (tasks.empty()) {
+        return;
+      }
+
+      Task task = std::move(tasks.front());
+      tasks.pop_front();
+      lock.unlock();
+      auto split = process(std::move(task));
+      lock.lock();
+
+      pending += split.size();
+      --pending;
+      for (auto& t : split) {
+        tasks.push_back(std::move(t));
+      }
+      ready.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(num_threads - 1);
+  for (unsigned int i = 1; i < num_threads; ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  return GroupComponents(forward, component);
+}
+
+/*
+    Gets a new graph with one node per strongly connected component, valued by the
+    component's smallest node, and an edge for each weight between different components
+*/
+template <typename N, typename E>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::Condensation() const {
+  auto forward = BuildAdjacency();
+  const std::size_t n = forward.nodes.size();
+
+  std::vector<std::size_t> roots(n);
+  for (std::size_t v = 0; v < n; ++v) {
+    roots[v] = v;
+  }
+
+  std::vector<std::size_t> order_index(n, kNone);
+  std::vector<std::size_t> low(n, kNone);
+  std::vector<std::size_t> component(n, kNone);
+  std::size_t next_component = 0;
+  Tarjan(forward, roots, [](std::size_t) { return true; },
+         [&next_component]() { return next_component++; }, order_index, low, component);
+
+  // nodes are visited in ascending order so representatives are created in ascending order
+  Graph<N, E> g;
+  std::vector<std::shared_ptr<Node>> representative(next_component);
+  for (std::size_t v = 0; v < n; ++v) {
+    auto& rep = representative[component[v]];
+    if (!rep) {
+      rep = std::make_shared<Node>(forward.nodes[v]->value_);
+      g.nodes_.emplace_hint(g.nodes_.end(), rep);
+    }
+  }
+
+  for (std::size_t v = 0; v < n; ++v) {
+    const auto& from = representative[component[v]];
+    for (const auto& [edge_to, costs] : forward.nodes[v]->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest || costs.empty()) {
+        continue;
+      }
+      auto found = forward.index.find(dest.get());
+      if (found == forward.index.end()) {
+        const Node* same = ResolveNode(dest.get());
+        found = same ? forward.index.find(same) : forward.index.end();
+      }
+      if (found == forward.index.end() || component[found->second] == component[v]) {
+        continue;
+      }
+
+      std::weak_ptr<Node> to = representative[component[found->second]];
+      from->edges_out_[to].insert(costs.begin(), costs.end());
+    }
+  }
+
+  g.RebuildIndexes();
+  return g;
+}
+
+/*
+    PageRank with the default options
+*/
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::PageRankResult gdwg::Graph<N, E>::PageRank() const {
+  return PageRank(PageRankOptions{});
+}
+
+/*
+    Power iteration in the pull model over a flat snapshot built once
+    each node sums the rank flowing in along its incoming edges, so threads write only
+    their own range of nodes; rank of nodes without outgoing edges is spread over every node
+*/
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::PageRankResult
+gdwg::Graph<N, E>::PageRank(const PageRankOptions& options) const {
+  if (!(options.damping >= 0 && options.damping <= 1)) {
+    throw std::runtime_error("Cannot call Graph::PageRank with a damping factor outside [0, 1]");
+  }
+
+  PageRankResult result;
+  auto forward = BuildAdjacency();
+  const std::size_t n = forward.nodes.size();
+  if (n == 0) {
+    result.converged = true;
+    return result;
+  }
+
+  // share of the source's rank carried by each edge
+  std::vector<double> share(forward.targets.size());
+  std::vector<bool> dangling(n, false);
+  for (std::size_t v = 0; v < n; ++v) {
+    double total = 0;
+    for (std::size_t e = forward.offsets[v]; e < forward.offsets[v + 1]; ++e) {
+      share[e] = 1;
+      if (options.weighted) {
+        if constexpr (std::is_arithmetic<E>::value) {
+          share[e] = 0;
+          for (const auto& cost : *forward.weights[e]) {
+            auto weight = static_cast<double>(cost);
+            if (weight < 0) {
+              throw std::runtime_error("Cannot call Graph::PageRank with negative weights");
+            }
+            share[e] += weight;
+          }
+        } else {
+          throw std::runtime_error("Cannot call Graph::PageRank weighted without numeric weights");
+        }
+      }
+      total += share[e];
+    }
+    for (std::size_t e = forward.offsets[v]; e < forward.offsets[v + 1]; ++e) {
+      share[e] = total > 0 ? share[e] / total : 0;
+    }
+    dangling[v] = !(total > 0);
+  }
+
+  // the same edges grouped by destination, with the source and share of each
+  std::vector<std::size_t> in_offsets(n + 1, 0);
+  for (auto w : forward.targets) {
+    ++in_offsets[w + 1];
+  }
+  for (std::size_t v = 0; v < n; ++v) {
+    in_offsets[v + 1] += in_offsets[v];
+  }
+  std::vector<std::size_t> in_sources(forward.targets.size());
+  std::vector<double> in_shares(forward.targets.size());
+  auto next_slot = in_offsets;
+  for (std::size_t v = 0; v < n; ++v) {
+    for (std::size_t e = forward.offsets[v]; e < forward.offsets[v + 1]; ++e) {
+      auto slot = next_slot[forward.targets[e]]++;
+      in_sources[slot] = v;
+      in_shares[slot] = share[e];
+    }
+  }
+
+  const double damping = options.damping;
+  const unsigned int num_threads = n < kSequentialRankCutoff ? 1 : options.num_threads;
+  std::vector<double> rank(n, 1.0 / n);
+  std::vector<double> next(n);
+  double dangling_rank = 0;
+  for (std::size_t v = 0; v < n; ++v) {
+    dangling_rank += dangling[v] ? rank[v] : 0;
+  }
+
+  while (result.residuals.size() < options.max_iterations) {
+    auto start = std::chrono::steady_clock::now();
+    const double base = (1 - damping) / n + damping * dangling_rank / n;
+    double residual = 0;
+    double next_dangling = 0;
+    std::mutex totals;
+    RunChunks(n, num_threads, [&](std::size_t first, std::size_t last) {
+      double local_residual = 0;
+      double local_dangling = 0;
+      for (std::size_t v = first; v < last; ++v) {
+        double sum = 0;
+        for (std::size_t e = in_offsets[v]; e < in_offsets[v + 1]; ++e) {
+          sum += rank[in_sources[e]] * in_shares[e];
+        }
+        next[v] = base + damping * sum;
+        local_residual += std::abs(next[v] - rank[v]);
+        local_dangling += dangling[v] ? next[v] : 0;
+      }
+      std::lock_guard<std::mutex> lock{totals};
+      residual += local_residual;
+      next_dangling += local_dangling;
+    });
+
+    rank.swap(next);
+    dangling_rank = next_dangling;
+    result.residuals.push_back(residual);
+    result.iteration_ms.push_back(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+    if (residual < options.tolerance) {
+      result.converged = true;
+      break;
+    }
+  }
+
+  result.ranks.reserve(n);
+  for (std::size_t v = 0; v < n; ++v) {
+    result.ranks.emplace_back(forward.nodes[v]->value_, rank[v]);
+  }
+  return result;
+}
+
+/*
+    Gets up to k cheapest paths from src to dst, answered from the cache when the same
+    query was made since the last mutation that could change its result
+*/
+template <typename N, typename E>
+std::vector<typename gdwg::Graph<N, E>::Path>
+gdwg::Graph<N, E>::ShortestPaths(const N& src, const N& dst, std::size_t k) const {
+  static_assert(std::is_arithmetic<E>::value, "Graph::ShortestPaths requires numeric weights");
+  if (FindNode(src) == nodes_.end() || FindNode(dst) == nodes_.end()) {
+    throw std::out_of_range(
+        "Cannot call Graph::ShortestPaths if src or dst node don't exist in the graph");
+  }
+
+  const bool cached = !Aliased() && path_cache_.capacity > 0;
+  typename PathCache::Key key{src, dst, k};
+  if (cached) {
+    std::lock_guard<std::mutex> lock{path_cache_mutex_};
+    auto found = path_cache_.index.find(key);
+    if (found != path_cache_.index.end()) {
+      path_cache_.entries.splice(path_cache_.entries.begin(), path_cache_.entries, found->second);
+      return found->second->second;
+    }
+  }
+
+  auto paths = FindShortestPaths(src, dst, k);
+  if (cached) {
+    std::lock_guard<std::mutex> lock{path_cache_mutex_};
+    if (path_cache_.index.find(key) == path_cache_.index.end()) {
+      path_cache_.entries.emplace_front(key, paths);
+      path_cache_.index.emplace(std::move(key), path_cache_.entries.begin());
+      while (path_cache_.entries.size() > path_cache_.capacity) {
+        path_cache_.index.erase(path_cache_.entries.back().first);
+        path_cache_.entries.pop_back();
+      }
+    }
+  }
+  return paths;
+}
+
+/*
+    Sets how many ShortestPaths results are kept, dropping the least recently used
+    a capacity of 0 turns the cache off
+*/
+template <typename N, typename E>
+void gdwg::Graph<N, E>::SetPathCacheCapacity(std::size_t capacity) {
+  path_cache_.capacity = capacity;
+  while (path_cache_.entries.size() > capacity) {
+    path_cache_.index.erase(path_cache_.entries.back().first);
+    path_cache_.entries.pop_back();
+  }
+}
+
+template <typename N, typename E>
+std::size_t gdwg::Graph<N, E>::PathCacheSize() const {
+  std::lock_guard<std::mutex> lock{path_cache_mutex_};
+  return path_cache_.entries.size();
+}
+
+/*
+    Yen's algorithm over a flat snapshot: each path after the first is the cheapest
+    candidate found by leaving a shorter path at one of its nodes, with the edges taken
+    there by earlier paths sharing that prefix removed and the prefix's nodes excluded
+    candidates of equal cost are taken in node order, so results do not depend on timing
+    the cost from every node to dst is found once up front and steers each search towards
+    dst (A*), so searches only settle nodes on or near the cheapest remaining routes
+*/
+template <typename N, typename E>
+std::vector<typename gdwg::Graph<N, E>::Path>
+gdwg::Graph<N, E>::FindShortestPaths(const N& src, const N& dst, std::size_t k) const {
+  std::vector<Path> result;
+  if (k == 0) {
+    return result;
+  }
+
+  auto adj = BuildAdjacency();
+  const std::size_t n = adj.nodes.size();
+  std::vector<E> hop(adj.targets.size());
+  for (std::size_t e = 0; e < adj.targets.size(); ++e) {
+    hop[e] = *adj.weights[e]->begin();
+    if (hop[e] < E{}) {
+      throw std::runtime_error("Cannot call Graph::ShortestPaths with negative weights");
+    }
+  }
+
+  const std::size_t source = adj.index.at(FindNode(src)->get());
+  const std::size_t target = adj.index.at(FindNode(dst)->get());
+  using Entry = std::pair<E, std::size_t>;
+  using Queue = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>;
+
+  // cheapest cost from each node to target, by Dijkstra over the reversed edges
+  // removing edges or nodes only makes routes dearer, so it never overestimates
+  std::vector<std::size_t> in_offsets(n + 1, 0);
+  for (auto w : adj.targets) {
+    ++in_offsets[w + 1];
+  }
+  for (std::size_t v = 0; v < n; ++v) {
+    in_offsets[v + 1] += in_offsets[v];
+  }
+  std::vector<std::pair<std::size_t, std::size_t>> in_edges(adj.targets.size());
+  auto next = in_offsets;
+  for (std::size_t v = 0; v < n; ++v) {
+    for (std::size_t e = adj.offsets[v]; e < adj.offsets[v + 1]; ++e) {
+      in_edges[next[adj.targets[e]]++] = {v, e};
+    }
+  }
+
+  std::vector<E> to_target(n);
+  std::vector<bool> reaches(n, false);
+  Queue queue;
+  to_target[target] = E{};
+  reaches[target] = true;
+  queue.emplace(E{}, target);
+  while (!queue.empty()) {
+    auto [d, w] = queue.top();
+    queue.pop();
+    if (to_target[w] < d) {
+      continue;
+    }
+    for (std::size_t i = in_offsets[w]; i < in_offsets[w + 1]; ++i) {
+      auto [v, e] = in_edges[i];
+      if (!reaches[v] || d + hop[e] < to_target[v]) {
+        to_target[v] = d + hop[e];
+        reaches[v] = true;
+        queue.emplace(to_target[v], v);
+      }
+    }
+  }
+  if (!reaches[source]) {
+    return result;
+  }
+
+  std::vector<bool> banned_node(n, false);
+  std::vector<bool> banned_edge(adj.targets.size(), false);
+  std::vector<E> dist(n);
+  std::vector<std::size_t> parent(n, kNone);
+  std::vector<std::size_t> via(n, kNone);
+  std::vector<std::size_t> touched;
+
+  // cost, nodes and edges of a route to target
+  using Route = std::tuple<E, std::vector<std::size_t>, std::vector<std::size_t>>;
+
+  // A* from start to target avoiding banned nodes and edges, resetting only the
+  // entries the previous search touched
+  auto cheapest = [&](std::size_t start) -> std::optional<Route> {
+    for (auto v : touched) {
+      parent[v] = kNone;
+    }
+    touched.clear();
+
+    Queue open;
+    dist[start] = E{};
+    parent[start] = start;
+    touched.push_back(start);
+    open.emplace(to_target[start], start);
+    while (!open.empty()) {
+      auto [f, v] = open.top();
+      open.pop();
+      if (dist[v] + to_target[v] < f) {
+        continue;
+      }
+      if (v == target) {
+        break;
+      }
+      for (std::size_t e = adj.offsets[v]; e < adj.offsets[v + 1]; ++e) {
+        auto w = adj.targets[e];
+        if (banned_edge[e] || banned_node[w] || !reaches[w]) {
+          continue;
+        }
+        if (parent[w] == kNone) {
+          touched.push_back(w);
+        } else if (!(dist[v] + hop[e] < dist[w])) {
+          continue;
+        }
+        dist[w] = dist[v] + hop[e];
+        parent[w] = v;
+        via[w] = e;
+        open.emplace(dist[w] + to_target[w], w);
+      }
+    }
+
+    if (parent[target] == kNone) {
+      return std::nullopt;
+    }
+    Route route{dist[target], {target}, {}};
+    auto& [cost, nodes, edges] = route;
+    for (auto v = target; v != start; v = parent[v]) {
+      nodes.push_back(parent[v]);
+      edges.push_back(via[v]);
+    }
+    std::reverse(nodes.begin(), nodes.end());
+    std::reverse(edges.begin(), edges.end());
+    return route;
+  };
+
+  std::vector<Route> found;
+  if (auto first = cheapest(source)) {
+    found.push_back(std::move(*first));
+  }
+  std::set<Route> candidates;
+  while (!found.empty() && found.size() < k) {
+    const auto previous = std::get<1>(found.back());
+    const auto previous_edges = std::get<2>(found.back());
+    E root_cost{};
+    for (std::size_t i = 0; i + 1 < previous.size(); ++i) {
+      std::vector<std::size_t> banned;
+      for (const auto& [cost, path, edges] : found) {
+        if (path.size() > i + 1 && std::equal(previous.begin(),
+                                              previous.begin() + static_cast<std::ptrdiff_t>(i + 1),
+                                              path.begin())) {
+          banned.push_back(edges[i]);
+          banned_edge[edges[i]] = true;
+        }
+      }
+
+      if (auto spur = cheapest(previous[i])) {
+        auto& [spur_cost, spur_nodes, spur_edges] = *spur;
+        std::vector<std::size_t> path(previous.begin(),
+                                      previous.begin() + static_cast<std::ptrdiff_t>(i));
+        path.insert(path.end(), spur_nodes.begin(), spur_nodes.end());
+        std::vector<std::size_t> edges(previous_edges.begin(),
+                                       previous_edges.begin() + static_cast<std::ptrdiff_t>(i));
+        edges.insert(edges.end(), spur_edges.begin(), spur_edges.end());
+        candidates.emplace(root_cost + spur_cost, std::move(path), std::move(edges));
+      }
+
+      for (auto e : banned) {
+        banned_edge[e] = false;
+      }
+      banned_node[previous[i]] = true;
+      root_cost += hop[previous_edges[i]];
+    }
+    for (std::size_t i = 0; i + 1 < previous.size(); ++i) {
+      banned_node[previous[i]] = false;
+    }
+
+    if (candidates.empty()) {
+      break;
+    }
+    found.push_back(*candidates.begin());
+    candidates.erase(candidates.begin());
+  }
+
+  result.reserve(found.size());
+  for (const auto& [cost, path, edges] : found) {
+    Path p{{}, cost};
+    p.nodes.reserve(path.size());
+    for (auto v : path) {
+      p.nodes.push_back(adj.nodes[v]->value_);
+    }
+    result.push_back(std::move(p));
+  }
+  return result;
+}
+
+template <typename N, typename E>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::InducedSubgraph(const std::vector<N>& keep) const {
+  std::unordered_set<const Node*> kept;
+  kept.reserve(keep.size());
+  for (const auto& val : keep) {
+    auto it = FindNode(val);
+    if (it == nodes_.end()) {
+      throw std::out_of_range(
+          "Cannot call Graph::InducedSubgraph if a node doesn't exist in the graph");
+    }
+    kept.insert(it->get());
+  }
+
+  return Extract([&kept](const Node* node) { return kept.count(node) > 0; },
+                 [](const N&, const N&, const E&) { return true; });
+}
+
+template <typename N, typename E>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::EgoGraph(const N& center, std::size_t hops) const {
+  auto it = FindNode(center);
+  if (it == nodes_.end()) {
+    throw std::out_of_range("Cannot call Graph::EgoGraph if the node doesn't exist in the graph");
+  }
+
+  // breadth first from center, one frontier per hop
+  const bool aliased = Aliased();
+  std::unordered_set<const Node*> kept{it->get()};
+  std::vector<const Node*> frontier{it->get()};
+  for (std::size_t hop = 0; hop < hops && !frontier.empty(); ++hop) {
+    std::vector<const Node*> next;
+    for (const auto* node : frontier) {
+      for (const auto& [edge_to, costs] : node->edges_out_) {
+        std::shared_ptr<Node> dest = edge_to.lock();
+        if (!dest || costs.empty()) {
+          continue;
+        }
+        const Node* target = aliased ? ResolveNode(dest.get()) : dest.get();
+        if (target != nullptr && kept.insert(target).second) {
+          next.push_back(target);
+        }
+      }
+    }
+    frontier.swap(next);
+  }
+
+  return Extract([&kept](const Node* node) { return kept.count(node) > 0; },
+                 [](const N&, const N&, const E&) { return true; });
+}
+
+template <typename N, typename E>
+template <typename P>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::Subgraph(P keep_node) const {
+  return Subgraph(std::move(keep_node), [](const N&, const N&, const E&) { return true; });
+}
+
+template <typename N, typename E>
+template <typename P, typename Q>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::Subgraph(P keep_node, Q keep_edge) const {
+  return Extract([&keep_node](const Node* node) { return keep_node(node->value_); }, keep_edge);
+}
+
+/*
+    Builds a graph from the nodes for which keep_node(node) holds and the weights between
+    them for which keep_edge(src, dst, w) holds
+    nodes and edges are visited in order and appended at the end of the new containers,
+    so the graph is built in one linear pass instead of a lookup per insertion
+*/
+template <typename N, typename E>
+template <typename P, typename Q>
+gdwg::Graph<N, E> gdwg::Graph<N, E>::Extract(P keep_node, Q keep_edge) const {
+  Graph<N, E> g;
+  std::unordered_map<const Node*, std::shared_ptr<Node>> copies;
+  for (const auto& node : nodes_) {
+    if (keep_node(node.get())) {
+      auto copy = std::make_shared<Node>(node->value_);
+      g.nodes_.emplace_hint(g.nodes_.end(), copy);
+      copies.emplace(node.get(), std::move(copy));
+    }
+  }
+
+  for (const auto& node : nodes_) {
+    auto from = copies.find(node.get());
+    if (from == copies.end()) {
+      continue;
+    }
+
+    auto& edges = from->second->edges_out_;
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      auto to = dest ? copies.find(dest.get()) : copies.end();
+      if (dest && to == copies.end()) {
+        const Node* same = ResolveNode(dest.get());
+        to = same ? copies.find(same) : copies.end();
+      }
+      if (to == copies.end()) {
+        continue;
+      }
+
+      WeightSet kept;
+      for (const auto& cost : costs) {
+        if (keep_edge(node->value_, dest->value_, cost)) {
+          kept.insert(cost);
+        }
+      }
+      if (!kept.empty()) {
+        edges.emplace_hint(edges.end(), std::weak_ptr<Node>{to->second}, std::move(kept));
+      }
+    }
+  }
+
+  g.RebuildIndexes();
+  return g;
+}
+
+template <typename N, typename E>
+template <typename P>
+auto gdwg::Graph<N, E>::Filter(P keep_node) const {
+  return Filter(std::move(keep_node), [](const N&, const N&, const E&) { return true; });
+}
+
+template <typename N, typename E>
+template <typename P, typename Q>
+typename gdwg::Graph<N, E>::template SubgraphView<P, Q>
+gdwg::Graph<N, E>::Filter(P keep_node, Q keep_edge) const {
+  return SubgraphView<P, Q>{this, std::move(keep_node), std::move(keep_edge)};
+}
+
+template <typename N, typename E>
+template <typename P, typename Q>
+bool gdwg::Graph<N, E>::SubgraphView<P, Q>::IsNode(const N& val) const {
+  return graph_->IsNode(val) && keep_node_(val);
+}
+
+template <typename N, typename E>
+template <typename P, typename Q>
+bool gdwg::Graph<N, E>::SubgraphView<P, Q>::IsConnected(const N& src, const N& dst) const {
+  if (!IsNode(src) || !IsNode(dst)) {
+    throw std::runtime_error(
+        "Cannot call SubgraphView::IsConnected if src or dst node don't exist in the view");
+  }
+
+  for (const auto& w : graph_->Weights(src, dst)) {
+    if (keep_edge_(src, dst, w)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename N, typename E>
+template <typename P, typename Q>
+std::vector<N> gdwg::Graph<N, E>::SubgraphView<P, Q>::GetNodes() const {
+  std::vector<N> v;
+  for (const auto& n : graph_->GetNodes()) {
+    if (keep_node_(n)) {
+      v.push_back(n);
+    }
+  }
+  return v;
+}
+
+template <typename N, typename E>
+template <typename P, typename Q>
+std::vector<N> gdwg::Graph<N, E>::SubgraphView<P, Q>::GetConnected(const N& src) const {
+  if (!IsNode(src)) {
+    throw std::out_of_range(
+        "Cannot call SubgraphView::GetConnected if src doesn't exist in the view");
+  }
+
+  std::vector<N> v;
+  for (const auto& dst : graph_->GetConnected(src)) {
+    if (keep_node_(dst) && IsConnected(src, dst)) {
+      v.push_back(dst);
+    }
+  }
+  return v;
+}
+
+template <typename N, typename E>
+template <typename P, typename Q>
+std::vector<E> gdwg::Graph<N, E>::SubgraphView<P, Q>::GetWeights(const N& src,
+                                                                  const N& dst) const {
+  if (!IsNode(src) || !IsNode(dst)) {
+    throw std::out_of_range(
+        "Cannot call SubgraphView::GetWeights if src or dst node don't exist in the view");
+  }
+
+  std::vector<E> v;
+  for (const auto& w : graph_->Weights(src, dst)) {
+    if (keep_edge_(src, dst, w)) {
+      v.push_back(w);
+    }
+  }
+  return v;
+}
+
 /*
-    Move Assignment
+    Drops the cached paths for which pred(entry) holds
 */
 template <typename N, typename E>
-gdwg::Graph<N, E>& gdwg::Graph<N, E>::operator=(gdwg::Graph<N, E>&& g) noexcept {
-  this->nodes_ = std::move(g.nodes_);
-  return *this;
+template <typename P>
+void gdwg::Graph<N, E>::ForgetPathsWhere(P pred) {
+  for (auto it = path_cache_.entries.begin(); it != path_cache_.entries.end();) {
+    if (pred(*it)) {
+      path_cache_.index.erase(it->first);
+      it = path_cache_.entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
 }
 
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::InsertNode(const N& val) {
-  auto new_node = std::make_shared<Node>(val);
-  auto inserted = this->nodes_.emplace(new_node);
-  return inserted.second;
+void gdwg::Graph<N, E>::ForgetPaths() const {
+  path_cache_.entries.clear();
+  path_cache_.index.clear();
 }
 
+/*
+    Drops the cached paths that cost, now the cheapest weight from src to dest, could change
+    a path from s to t through the edge costs at least dist(s, src) + cost + dist(dest, t),
+    so an entry holding k paths is kept when that is more than its dearest path, and one
+    holding fewer when s can't reach src or dest can't reach t
+    both searches stop at the dearest cached path, so an edge far from every cached path
+    is cheap to check; a self loop is on no loopless path and drops nothing
+*/
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::InsertEdge(const N& src, const N& dest, const E& w) {
-  if (!IsNode(src) || !IsNode(dest)) {
-    throw std::runtime_error(
-        "Cannot call Graph::InsertEdge when either src or dst node does not exist");
-  }
+void gdwg::Graph<N, E>::ForgetPathsThrough(const Node* src, const Node* dest, const E& cost) {
+  if constexpr (!std::is_arithmetic<E>::value) {
+    ForgetPaths();
+  } else {
+    if (src == dest) {
+      return;
+    }
+    // paths are only cached for graphs with no negative weights, and a copy sharing these
+    // nodes can change them without telling this graph
+    if (cost < E{} || Aliased()) {
+      ForgetPaths();
+      return;
+    }
 
-  auto src_it = std::find_if(nodes_.begin(), nodes_.end(), [&src](std::shared_ptr<Node> const& n) {
-    return n->GetValue() == src;
-  });
+    auto full = [](const typename PathCache::Entry& entry) {
+      return entry.second.size() >= std::get<2>(entry.first);
+    };
+    bool bounded = true;
+    std::optional<E> budget;
+    for (const auto& entry : path_cache_.entries) {
+      if (!full(entry)) {
+        bounded = false;
+      } else if (!(entry.second.back().cost < cost)) {
+        E left = entry.second.back().cost - cost;
+        budget = budget && left < *budget ? *budget : left;
+      }
+    }
+    if (bounded && !budget) {
+      return;
+    }
 
-  auto dst_it = std::find_if(nodes_.begin(), nodes_.end(), [&dest](std::shared_ptr<Node> const& n) {
-    return n->GetValue() == dest;
-  });
+    auto from_dest = CostsFrom(dest, bounded ? budget : std::nullopt, nullptr);
+    ForgetPathsWhere([this, src, &cost, &from_dest, &full](const typename PathCache::Entry& entry) {
+      const auto& [s, t, k] = entry.first;
+      auto s_it = nodes_.find(s);
+      auto t_it = nodes_.find(t);
+      if (s_it == nodes_.end() || t_it == nodes_.end()) {
+        return true;
+      }
+      auto to_t = from_dest.find(t_it->get());
+      if (to_t == from_dest.end()) {
+        return false;
+      }
 
-  return src_it->get()->AddEdgeTo(*dst_it, w);
+      std::optional<E> left;
+      if (full(entry)) {
+        const E& dearest = entry.second.back().cost;
+        if (dearest < cost + to_t->second) {
+          return false;
+        }
+        left = dearest - cost - to_t->second;
+      }
+      auto from_s = CostsFrom(s_it->get(), left, src);
+      auto to_src = from_s.find(src);
+      return to_src != from_s.end() &&
+             (!left || !(entry.second.back().cost < to_src->second + cost + to_t->second));
+    });
+  }
 }
 
+/*
+    Dijkstra from start, each hop costing the smallest weight between its nodes, giving the
+    cheapest cost to every node reached for no more than budget, if any
+    stops once stop is settled
+*/
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::DeleteNode(const N& n) {
-  if (!IsNode(n)) {
-    return false;
-  }
-
-  auto n_it = std::find_if(nodes_.begin(), nodes_.end(),
-                           [&n](std::shared_ptr<Node> const& s) { return s->GetValue() == n; });
-  nodes_.erase(n_it);
+std::unordered_map<const typename gdwg::Graph<N, E>::Node*, E>
+gdwg::Graph<N, E>::CostsFrom(const Node* start, std::optional<E> budget, const Node* stop) const {
+  using Entry = std::pair<E, const Node*>;
+  auto dearer = [](const Entry& lhs, const Entry& rhs) { return rhs.first < lhs.first; };
+  std::priority_queue<Entry, std::vector<Entry>, decltype(dearer)> queue{dearer};
+  std::unordered_map<const Node*, E> settled;
+  std::unordered_map<const Node*, E> best{{start, E{}}};
+  queue.emplace(E{}, start);
+  while (!queue.empty()) {
+    auto [d, node] = queue.top();
+    queue.pop();
+    if (!settled.emplace(node, d).second) {
+      continue;
+    }
+    if (node == stop) {
+      break;
+    }
 
-  return true;
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> next = edge_to.lock();
+      if (!next || costs.empty() || settled.count(next.get()) > 0) {
+        continue;
+      }
+      E through = d + *costs.begin();
+      if (budget && *budget < through) {
+        continue;
+      }
+      auto [it, added] = best.emplace(next.get(), through);
+      if (added || through < it->second) {
+        it->second = through;
+        queue.emplace(through, next.get());
+      }
+    }
+  }
+  return settled;
 }
 
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::Replace(const N& oldData, const N& newData) {
-  if (!IsNode(oldData)) {
-    throw std::runtime_error("Cannot call Graph::Replace on a node that doesn't exist");
+typename gdwg::Graph<N, E>::Adjacency gdwg::Graph<N, E>::BuildAdjacency() const {
+  Adjacency adj;
+  adj.nodes.reserve(nodes_.size());
+  adj.index.reserve(nodes_.size());
+  for (const auto& node : nodes_) {
+    adj.index.emplace(node.get(), adj.nodes.size());
+    adj.nodes.push_back(node.get());
   }
 
-  if (IsNode(newData)) {
-    return false;
+  adj.offsets.reserve(adj.nodes.size() + 1);
+  adj.offsets.push_back(0);
+  for (const auto* node : adj.nodes) {
+    for (const auto& [edge_to, costs] : node->edges_out_) {
+      std::shared_ptr<Node> dest = edge_to.lock();
+      if (!dest || costs.empty()) {
+        continue;
+      }
+      auto found = adj.index.find(dest.get());
+      if (found == adj.index.end()) {
+        const Node* same = ResolveNode(dest.get());
+        found = same ? adj.index.find(same) : adj.index.end();
+      }
+      if (found != adj.index.end()) {
+        adj.targets.push_back(found->second);
+        adj.weights.push_back(&costs);
+      }
+    }
+    adj.offsets.push_back(adj.targets.size());
   }
 
-  auto it = std::find_if(nodes_.begin(), nodes_.end(), [&oldData](std::shared_ptr<Node> const& n) {
-    return n->GetValue() == oldData;
-  });
-  it->get()->SetValue(newData);
-
-  return true;
+  return adj;
 }
 
+/*
+    Gets the same snapshot with every edge reversed, the index is not copied
+*/
 template <typename N, typename E>
-void gdwg::Graph<N, E>::MergeReplace(const N& oldData, const N& newData) {
-  if (!IsNode(oldData) || !IsNode(newData)) {
-    throw std::runtime_error(
-        "Cannot call Graph::MergeReplace on old or new data if they don't exist in the graph");
+typename gdwg::Graph<N, E>::Adjacency gdwg::Graph<N, E>::Adjacency::Transpose() const {
+  Adjacency reversed;
+  reversed.nodes = nodes;
+  reversed.offsets.assign(nodes.size() + 1, 0);
+  for (auto w : targets) {
+    ++reversed.offsets[w + 1];
+  }
+  for (std::size_t v = 0; v < nodes.size(); ++v) {
+    reversed.offsets[v + 1] += reversed.offsets[v];
   }
 
-  auto old_it =
-      std::find_if(nodes_.begin(), nodes_.end(),
-                   [&oldData](std::shared_ptr<Node> const& n) { return n->GetValue() == oldData; });
-  auto new_it =
-      std::find_if(nodes_.begin(), nodes_.end(),
-                   [&newData](std::shared_ptr<Node> const& n) { return n->GetValue() == newData; });
-
-  // merge outgoing edges
-  auto pair = old_it->get()->EdgesWeights();
-  for (const auto& ew : pair) {
-    std::shared_ptr<Node> node = ew.first.lock();
-    auto n = node->GetValue();
-    auto costs = ew.second;
-
-    auto it = std::find_if(nodes_.begin(), nodes_.end(),
-                           [&n](std::shared_ptr<Node> const& s) { return s->GetValue() == n; });
-    for (const auto& cost : costs) {
-      new_it->get()->AddEdgeTo(*it, cost);
+  reversed.targets.resize(targets.size());
+  auto next = reversed.offsets;
+  for (std::size_t v = 0; v < nodes.size(); ++v) {
+    for (std::size_t e = offsets[v]; e < offsets[v + 1]; ++e) {
+      reversed.targets[next[targets[e]]++] = v;
     }
   }
 
-  // merge incoming edges
-  for (const auto& node : nodes_) {
-    if (!node->IsEdge(oldData)) {
+  return reversed;
+}
+
+/*
+    Iterative Tarjan over the nodes reachable from roots for which in_scope holds
+    writes a component id from next_component() for each visited node
+    a node is on the Tarjan stack while it has an order index but no component
+*/
+template <typename N, typename E>
+template <typename P, typename F>
+void gdwg::Graph<N, E>::Tarjan(const Adjacency& adj,
+                               const std::vector<std::size_t>& roots,
+                               P in_scope,
+                               F next_component,
+                               std::vector<std::size_t>& order_index,
+                               std::vector<std::size_t>& low,
+                               std::vector<std::size_t>& component) {
+  std::size_t counter = 0;
+  std::vector<std::size_t> visited;
+  std::vector<std::pair<std::size_t, std::size_t>> calls;
+
+  auto visit = [&](std::size_t v) {
+    order_index[v] = low[v] = counter++;
+    visited.push_back(v);
+    calls.emplace_back(v, adj.offsets[v]);
+  };
+
+  for (auto root : roots) {
+    if (order_index[root] != kNone || !in_scope(root)) {
       continue;
     }
 
-    auto weights = node->GetWeights(oldData);
+    visit(root);
+    while (!calls.empty()) {
+      const std::size_t v = calls.back().first;
+      std::size_t& edge = calls.back().second;
 
-    for (const auto& weight : weights) {
-      node->AddEdgeTo(*new_it, weight);
-    }
-  }
+      if (edge < adj.offsets[v + 1]) {
+        const std::size_t w = adj.targets[edge++];
+        if (!in_scope(w)) {
+          continue;
+        }
+        if (order_index[w] == kNone) {
+          visit(w);
+        } else if (component[w] == kNone) {
+          low[v] = std::min(low[v], order_index[w]);
+        }
+        continue;
+      }
 
-  nodes_.erase(old_it);
-}
+      calls.pop_back();
+      if (!calls.empty()) {
+        auto parent = calls.back().first;
+        low[parent] = std::min(low[parent], low[v]);
+      }
 
-template <typename N, typename E>
-void gdwg::Graph<N, E>::Clear() {
-  for (auto itr = nodes_.begin(); itr != nodes_.end();) {
-    itr = nodes_.erase(itr);
+      if (low[v] == order_index[v]) {
+        const std::size_t id = next_component();
+        std::size_t w;
+        do {
+          w = visited.back();
+          visited.pop_back();
+          component[w] = id;
+        } while (w != v);
+      }
+    }
   }
 }
 
+/*
+    Groups node values by component id, components ordered by their first node
+*/
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::IsNode(const N& val) const {
-  for (const auto& n : nodes_) {
-    if (n->GetValue() == val) {
-      return true;
+std::vector<std::vector<N>>
+gdwg::Graph<N, E>::GroupComponents(const Adjacency& adj,
+                                   const std::vector<std::size_t>& component) {
+  std::vector<std::vector<N>> groups;
+  std::unordered_map<std::size_t, std::size_t> slot;
+  for (std::size_t v = 0; v < adj.nodes.size(); ++v) {
+    auto found = slot.emplace(component[v], groups.size());
+    if (found.second) {
+      groups.emplace_back();
     }
+    groups[found.first->second].push_back(adj.nodes[v]->value_);
   }
-  return false;
+  return groups;
 }
 
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::IsConnected(const N& src, const N& dest) const {
-  if (!IsNode(src) || !IsNode(dest)) {
-    throw std::runtime_error(
-        "Cannot call Graph::IsConnected if src or dst node don't exist in the graph");
-  }
-  auto src_it = std::find_if(nodes_.begin(), nodes_.end(), [&src](std::shared_ptr<Node> const& n) {
-    return n->GetValue() == src;
-  });
-
-  return src_it->get()->IsEdge(dest);
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cbegin() const {
+  return nodes_.empty() ? cend() : Seek(nodes_.begin(), nodes_.begin()->get()->edges_out_.begin());
 }
 
 template <typename N, typename E>
-std::vector<N> gdwg::Graph<N, E>::GetNodes() const {
-  std::vector<N> v;
-  v.reserve(nodes_.size());
-  for (const auto& n : this->nodes_) {
-    v.push_back(n->GetValue());
-  }
-  std::sort(v.begin(), v.end());
-  return v;
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cend() const {
+  return {nodes_.end(), nodes_.begin(), nodes_.end(), {}, {}, {}, {}, {}, {}};
 }
 
+/*
+    Gets an iterator to the first edge at or after destination to of source from
+*/
 template <typename N, typename E>
-std::vector<N> gdwg::Graph<N, E>::GetConnected(const N& src) const {
-  if (!IsNode(src)) {
-    throw std::out_of_range("Cannot call Graph::GetConnected if src doesn't exist in the graph");
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::Seek(NodeItr from, EdgeItr to) const {
+  if (from == nodes_.end()) {
+    return cend();
   }
 
-  auto src_it = std::find_if(nodes_.begin(), nodes_.end(), [&src](std::shared_ptr<Node> const& n) {
-    return n->GetValue() == src;
-  });
-
-  return src_it->get()->GetEdges();
+  auto& edges = from->get()->edges_out_;
+  const_iterator it{from, nodes_.begin(), nodes_.end(), to, edges.begin(), edges.end(), {}, {}, {}};
+  it.SeekForward();
+  return it;
 }
 
+/*
+    Iterators to the first edge from a source not less than src, and to the first edge not
+    less than (src, dst), found through the ordered node and edge containers in O(log V)
+*/
 template <typename N, typename E>
-std::vector<E> gdwg::Graph<N, E>::GetWeights(const N& src, const N& dest) const {
-  if (!IsNode(src) || !IsNode(dest)) {
-    throw std::out_of_range(
-        "Cannot call Graph::GetWeights if src or dst node don't exist in the graph");
-  }
-
-  auto src_it = std::find_if(nodes_.begin(), nodes_.end(), [&src](std::shared_ptr<Node> const& n) {
-    return n->GetValue() == src;
-  });
-
-  return src_it->get()->GetWeights(dest);
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::LowerBound(const N& src) const {
+  auto from = LowerBoundNode(src);
+  return from == nodes_.end() ? cend() : Seek(from, from->get()->edges_out_.begin());
 }
 
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::erase(const N& src, const N& dest, const E& w) {
-  if (!IsNode(src) || !IsNode(dest)) {
-    return false;
+typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::LowerBound(const N& src,
+                                                                         const N& dst) const {
+  auto from = LowerBoundNode(src);
+  if (from == nodes_.end()) {
+    return cend();
   }
 
-  auto src_itr = std::find_if(nodes_.begin(), nodes_.end(), [&src](std::shared_ptr<Node> const& n) {
-    return n->GetValue() == src;
-  });
-
-  return src_itr->get()->DeleteEdge(dest, w);
-}
-
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator
-gdwg::Graph<N, E>::find(const N& src, const N& dest, const E& cost) const {
-  for (auto it = begin(); it != end(); ++it) {
-    auto [from, to, weight] = *it;
-    if (src == from && dest == to && cost == weight) {
-      return it;
-    }
+  auto& edges = from->get()->edges_out_;
+  if (src < from->get()->value_) {
+    return Seek(from, edges.begin());
+  }
+  if (!Aliased()) {
+    return Seek(from, edges.lower_bound(dst));
   }
-  return cend();
-}
 
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::erase(const_iterator it) {
-  for (auto itr = begin(); itr != end(); ++itr) {
-    if (it == itr) {
-      auto [src, dest, cost] = *itr;
-      auto tmp = ++itr;
-      erase(src, dest, cost);
-      return tmp;
+  // the edge to the smallest destination not less than dst, wherever it sits
+  auto to = edges.end();
+  std::shared_ptr<Node> best;
+  for (auto it = edges.begin(); it != edges.end(); ++it) {
+    std::shared_ptr<Node> dest = it->first.lock();
+    if (dest && !(dest->value_ < dst) && (!best || dest->value_ < best->value_)) {
+      to = it;
+      best = std::move(dest);
     }
   }
-  return cend();
+  return Seek(from, to);
 }
 
+/*
+    Gets the edges whose source is between src_lo and src_hi inclusive, in iterator order
+*/
 template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cbegin() const {
-  auto first = nodes_.begin();
-
-  if (first == nodes_.end()) {
-    return cend();
+typename gdwg::Graph<N, E>::template View<typename gdwg::Graph<N, E>::const_iterator>
+gdwg::Graph<N, E>::EdgesFrom(const N& src_lo, const N& src_hi) const {
+  auto first = LowerBoundNode(src_lo);
+  if (src_hi < src_lo || first == nodes_.end()) {
+    return {cend(), cend()};
   }
 
-  // get first node_from  with node_to valid
-  auto edges = first->get()->edges_out_;
+  // the range ends at the first source after src_hi in iterator order, which is also the
+  // first one after first when a copy sharing these nodes has left them out of order
+  auto last = !Aliased() ? nodes_.upper_bound(src_hi)
+                         : std::find_if(first, nodes_.end(), [&src_hi](const auto& node) {
+                             return src_hi < node->value_;
+                           });
+  return {Seek(first, first->get()->edges_out_.begin()),
+          last == nodes_.end() ? cend() : Seek(last, last->get()->edges_out_.begin())};
+}
 
-  // get first node source with connections
-  while (first != nodes_.end() && edges.begin() == edges.end()) {
-    ++first;
-    edges = first->get()->edges_out_;
+/*
+    Finds the node holding the smallest value not less than val in O(log V)
+    a copy sharing these nodes can rename them and leave nodes_ out of order, so every node
+    is checked instead
+*/
+template <typename N, typename E>
+typename gdwg::Graph<N, E>::NodeItr gdwg::Graph<N, E>::LowerBoundNode(const N& val) const {
+  if (!Aliased()) {
+    return nodes_.lower_bound(val);
   }
 
-  // get first node destination skipping invalid weak pointers (owner was deleted)
-  if (first != nodes_.end()) {
-    std::shared_ptr<Node> sp = edges.begin()->first.lock();
-    while (first != nodes_.end() && !sp) {
-      ++first;
-      if (first == nodes_.end()) {
-        continue;
-      }
-      edges = first->get()->edges_out_;
-      sp = edges.begin()->first.lock();
+  auto best = nodes_.end();
+  for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
+    if (!((*it)->value_ < val) && (best == nodes_.end() || (*it)->value_ < (*best)->value_)) {
+      best = it;
     }
   }
-
-  if (first != nodes_.end()) {
-    return {first,
-            std::prev(first),
-            nodes_.end(),
-
-            first->get()->edges_out_.begin(),
-            first->get()->edges_out_.begin(),
-            first->get()->edges_out_.end(),
-
-            first->get()->edges_out_.begin()->second.begin(),
-            first->get()->edges_out_.begin()->second.begin(),
-            first->get()->edges_out_.begin()->second.end()};
-  }
-
-  return cend();
-}
-
-template <typename N, typename E>
-typename gdwg::Graph<N, E>::const_iterator gdwg::Graph<N, E>::cend() const {
-  return {nodes_.end(), std::prev(nodes_.begin()), nodes_.end(), {}, {}, {}, {}, {}, {}};
+  return best;
 }
 
 template <typename N, typename E>
@@ -404,7 +3525,7 @@ operator*() const {
 
 template <typename N, typename E>
 typename gdwg::Graph<N, E>::const_iterator& gdwg::Graph<N, E>::const_iterator::operator++() {
-  // incrementing empty graph
+  // incrementing the end iterator
   if (node_from_itr_ == node_from_end_) {
     return *this;
   }
@@ -412,175 +3533,99 @@ typename gdwg::Graph<N, E>::const_iterator& gdwg::Graph<N, E>::const_iterator::o
   ++weight_itr_;
   if (weight_itr_ == weight_end_) {
     ++node_to_itr_;
-
-    // no more edges for current src
-    // find src node with edges
-    if (node_to_itr_ == node_to_end_) {
-      Next();
-
-      // still have edges for current src
-    } else {
-      // check weak pointer still valid
-      // get first valid dest with edges
-      std::shared_ptr<Node> sp = node_to_itr_->first.lock();
-      while (node_to_itr_ != node_to_end_ && !sp) {
-        ++node_to_itr_;
-        sp = (node_to_itr_ != node_to_end_) ? node_to_itr_->first.lock() : sp;
-      }
-
-      if (sp) {
-        weight_itr_ = node_to_itr_->second.begin();
-        weight_start_ = node_to_itr_->second.begin();
-        weight_end_ = node_to_itr_->second.end();
-
-        // no edges for current
-      } else {
-        Next();
-      }
-    }
+    SeekForward();
   }
 
   return *this;
 }
 
 /*
-    Find from the start of the graph, the first source node with edges
+    Moves to the first weight of the first valid destination at or after node_to_itr_,
+    continuing through later sources, or to the end if there is none
+    a destination is valid if the owner of its weak pointer still exists and it has weights
 */
 template <typename N, typename E>
-void gdwg::Graph<N, E>::const_iterator::Next() {
-  // find a node source with edges
-  do {
-    ++node_from_itr_;
-
-    if (node_from_itr_ != node_from_end_) {
-      node_to_itr_ = node_from_itr_->get()->edges_out_.begin();
-      node_to_end_ = node_from_itr_->get()->edges_out_.end();
-      node_to_start_ = node_from_itr_->get()->edges_out_.begin();
-
-      if (node_to_itr_ == node_to_end_) {
-        continue;
-      }
-
-      // find valid destination with edges
-      std::shared_ptr<Node> sp = node_to_itr_->first.lock();
-
-      if (!sp) {
-        node_to_itr_ = node_to_end_;  // owner of weak pointer dead  reset loop
-
-        // set weight iterators for valid node
-      } else {
+void gdwg::Graph<N, E>::const_iterator::SeekForward() {
+  while (node_from_itr_ != node_from_end_) {
+    for (; node_to_itr_ != node_to_end_; ++node_to_itr_) {
+      if (!node_to_itr_->first.expired() && !node_to_itr_->second.empty()) {
         weight_itr_ = node_to_itr_->second.begin();
         weight_start_ = node_to_itr_->second.begin();
         weight_end_ = node_to_itr_->second.end();
+        return;
       }
     }
-  } while (node_from_itr_ != node_from_end_ && node_to_itr_ == node_to_end_);
+
+    if (++node_from_itr_ != node_from_end_) {
+      auto& edges = node_from_itr_->get()->edges_out_;
+      node_to_itr_ = edges.begin();
+      node_to_start_ = edges.begin();
+      node_to_end_ = edges.end();
+    }
+  }
 }
 
 template <typename N, typename E>
 typename gdwg::Graph<N, E>::const_iterator& gdwg::Graph<N, E>::const_iterator::operator--() {
-  // empty graph
-  if (node_from_start_ == std::prev(node_from_end_)) {
-    return *this;
-  }
-
-  // decrementing at end iterator
-  // decrementing after crbegin() (cend()) is called
-  if (weight_itr_ == weight_start_ && weight_start_ == weight_end_ &&
-      node_to_itr_ == node_to_start_ && node_to_start_ == node_to_end_) {
-    Prev(true);
-    return *this;
-  }
-
-  // decrementing at end iterator
-  // decrementing when at end iterator for *this' iterators (ie incrementing iterator until end then
-  // decrement)
-  if (node_from_itr_ == node_from_end_ && node_to_itr_ == node_to_end_ &&
-      weight_itr_ == weight_end_) {
-    Prev(true);
-    return *this;
-  }
-
-  // decrementing start of weights
-  if (weight_itr_ == weight_start_) {
-    if (node_to_itr_ == node_to_start_) {
-      Prev(false);
+  // decrementing the end iterator starts after the last destination of the last source
+  if (node_from_itr_ == node_from_end_) {
+    if (node_from_start_ == node_from_end_) {
       return *this;
-
-    } else {
-      --node_to_itr_;
-    }
-
-    // find first valid destination node (owner of weak pointer still exists)
-    std::shared_ptr<Node> sp = node_to_itr_->first.lock();
-    while (node_to_itr_ != node_to_start_ && !sp) {
-      --node_to_itr_;
-      sp = node_to_itr_->first.lock();
-    }
-
-    if (node_to_itr_ == node_to_start_) {
-      sp = node_to_itr_->first.lock();
     }
 
-    // set weight iterators for valid node
-    if (sp) {
-      weight_itr_ = std::prev(node_to_itr_->second.end());
-      weight_start_ = node_to_itr_->second.begin();
-      weight_end_ = node_to_itr_->second.end();
-
-      // no edges for current
-    } else {
-      Prev(false);
-    }
+    node_from_itr_ = std::prev(node_from_end_);
+    auto& edges = node_from_itr_->get()->edges_out_;
+    node_to_itr_ = edges.end();
+    node_to_start_ = edges.begin();
+    node_to_end_ = edges.end();
+    SeekBackward();
+    return *this;
+  }
 
-  } else {
+  if (weight_itr_ != weight_start_) {
     --weight_itr_;
+  } else {
+    SeekBackward();
   }
 
   return *this;
 }
 
 /*
-    Find from the end of the graph, the first source node with edges
+    Moves to the last weight of the last valid destination before node_to_itr_,
+    continuing through earlier sources; stays put if there is none
 */
 template <typename N, typename E>
-void gdwg::Graph<N, E>::const_iterator::Prev(bool flag) {
-  do {
-    if (flag) {  // get element before end()
-      node_from_itr_ = std::prev(node_from_end_);
-      flag = false;
-
-    } else {
-      --node_from_itr_;
+void gdwg::Graph<N, E>::const_iterator::SeekBackward() {
+  auto from = node_from_itr_;
+  auto to = node_to_itr_;
+  auto to_start = node_to_start_;
+  auto to_end = node_to_end_;
+  while (true) {
+    while (to != to_start) {
+      --to;
+      if (!to->first.expired() && !to->second.empty()) {
+        node_from_itr_ = from;
+        node_to_itr_ = to;
+        node_to_start_ = to_start;
+        node_to_end_ = to_end;
+        weight_itr_ = std::prev(to->second.end());
+        weight_start_ = to->second.begin();
+        weight_end_ = to->second.end();
+        return;
+      }
     }
 
-    if (node_from_itr_ != node_from_start_) {
-      // reset loop when current node source has no edges
-      if (node_from_itr_->get()->edges_out_.begin() == node_from_itr_->get()->edges_out_.end()) {
-        node_to_start_ = node_from_itr_->get()->edges_out_.begin();
-        node_to_end_ = node_from_itr_->get()->edges_out_.begin();
-
-        // get valid node destination (weak pointer's owner still exists)
-      } else {
-        node_to_itr_ = std::prev(node_from_itr_->get()->edges_out_.end());
-        node_to_end_ = node_from_itr_->get()->edges_out_.end();
-        node_to_start_ = node_from_itr_->get()->edges_out_.begin();
-
-        std::shared_ptr<Node> sp = node_to_itr_->first.lock();
-        if (!sp) {
-          node_to_start_ = node_to_end_;  // owner of weak pointer dead reset loop
-
-          // set weight iterators for valid node
-        } else {
-          weight_itr_ = std::prev(node_to_itr_->second.end());  // last element
-          weight_start_ = node_to_itr_->second.begin();
-          weight_end_ = node_to_itr_->second.end();
-        }
-      }
+    if (from == node_from_start_) {
+      return;
     }
 
-    // while not finished with node from and node to is empty (ie no edges)
-  } while (node_from_itr_ != node_from_start_ && node_to_start_ == node_to_end_);
+    --from;
+    auto& edges = from->get()->edges_out_;
+    to = edges.end();
+    to_start = edges.begin();
+    to_end = edges.end();
+  }
 }
 
 template <typename N, typename E>
@@ -600,10 +3645,10 @@ operator--(int) {
 }
 
 template <typename N, typename E>
-gdwg::Graph<N, E>::Node::Node(N value) : value_{value} {}
+gdwg::Graph<N, E>::Node::Node(N value) : value_{std::move(value)} {}
 
 template <typename N, typename E>
-N gdwg::Graph<N, E>::Node::GetValue() const {
+const N& gdwg::Graph<N, E>::Node::GetValue() const {
   return this->value_;
 }
 
@@ -613,60 +3658,73 @@ void gdwg::Graph<N, E>::Node::SetValue(const N& newData) {
 }
 
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::Node::AddEdgeTo(const std::shared_ptr<Node>& n, const E& cost) {
+void gdwg::Graph<N, E>::Node::SetValue(N&& newData) {
+  this->value_ = std::move(newData);
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::Node::AddEdgeTo(const std::shared_ptr<Node>& n,
+                                        const E& cost,
+                                        bool exhaustive) {
+  return AddWeight(n, cost, exhaustive);
+}
+
+template <typename N, typename E>
+bool gdwg::Graph<N, E>::Node::AddEdgeTo(const std::shared_ptr<Node>& n,
+                                        E&& cost,
+                                        bool exhaustive) {
+  return AddWeight(n, std::move(cost), exhaustive);
+}
+
+template <typename N, typename E>
+template <typename W>
+bool gdwg::Graph<N, E>::Node::AddWeight(const std::shared_ptr<Node>& n,
+                                        W&& cost,
+                                        bool exhaustive) {
   std::weak_ptr<Node> edge_to = n;
 
-  auto it = std::find_if(edges_out_.begin(), edges_out_.end(),
-                         [&n](std::pair<std::weak_ptr<Node>, std::set<E, Comparator<E>>> const& p) {
-                           std::shared_ptr<Node> node = p.first.lock();
-                           return node && node->GetValue() == n->GetValue();
-                         });
+  auto it = FindEdgeIn(edges_out_, n->value_, exhaustive);
 
   if (it != edges_out_.end()) {
-    return it->second.emplace(cost).second;
+    return it->second.emplace(std::forward<W>(cost)).second;
   }
 
-  return this->edges_out_.emplace(edge_to, std::set<E, Comparator<E>>{cost}).second;
+  WeightSet costs;
+  costs.emplace(std::forward<W>(cost));
+  return this->edges_out_.emplace(edge_to, std::move(costs)).second;
 }
 
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::Node::IsEdge(const N& dest) const {
-  auto dest_it =
-      std::find_if(edges_out_.begin(), edges_out_.end(),
-                   [&dest](std::pair<std::weak_ptr<Node>, std::set<E, Comparator<E>>> const& p) {
-                     std::shared_ptr<Node> n = p.first.lock();
-                     return n && n->GetValue() == dest;
-                   });
-  return dest_it != edges_out_.end();
+bool gdwg::Graph<N, E>::Node::IsEdge(const N& dest, bool exhaustive) const {
+  return FindEdgeIn(edges_out_, dest, exhaustive) != edges_out_.end();
 }
 
 template <typename N, typename E>
-bool gdwg::Graph<N, E>::Node::DeleteEdge(const N& dest, const E& cost) {
-  auto dest_it = std::find_if(
-      edges_out_.begin(), edges_out_.end(),
-      [&dest, &cost](std::pair<std::weak_ptr<Node>, std::set<E, Comparator<E>>> const& p) {
-        std::shared_ptr<Node> n = p.first.lock();
-        std::set<E, Comparator<E>> c = p.second;
-        return n && n->GetValue() == dest && c.find(cost) != c.end();
-      });
+bool gdwg::Graph<N, E>::Node::DeleteEdge(const N& dest, const E& cost, bool exhaustive) {
+  auto dest_it = FindEdgeIn(edges_out_, dest, exhaustive);
+  if (dest_it == edges_out_.end()) {
+    return false;
+  }
 
   // remove cost from set of weights of connections to dest
-  if (dest_it != edges_out_.end()) {
-    auto& costs = dest_it->second;
-    auto itr = std::find_if(costs.begin(), costs.end(), [&cost](E const& c) { return cost == c; });
-
-    if (itr != costs.end()) {
-      costs.erase(itr);
-    }
-    return true;
+  auto& costs = dest_it->second;
+  auto itr = costs.find(cost);
+  if (itr == costs.end()) {
+    return false;
   }
 
-  return false;
+  costs.erase(itr);
+  // drop dest once no weights are left so it no longer counts as connected
+  if (costs.empty()) {
+    edges_out_.erase(dest_it);
+  }
+  return true;
 }
 
 template <typename N, typename E>
 std::vector<N> gdwg::Graph<N, E>::Node::GetEdges() const {
   std::vector<N> v;
+  v.reserve(edges_out_.size());
 
   for (auto it = edges_out_.begin(); it != edges_out_.end(); ++it) {
     auto wp = it->first.lock();
@@ -675,7 +3733,9 @@ std::vector<N> gdwg::Graph<N, E>::Node::GetEdges() const {
     }
   }
 
-  std::sort(v.begin(), v.end());
+  if (!std::is_sorted(v.begin(), v.end())) {
+    std::sort(v.begin(), v.end());
+  }
   return v;
 }
 
@@ -683,15 +3743,10 @@ std::vector<N> gdwg::Graph<N, E>::Node::GetEdges() const {
     Gets all weights connected to dest node
 */
 template <typename N, typename E>
-std::vector<E> gdwg::Graph<N, E>::Node::GetWeights(const N& dest) const {
+std::vector<E> gdwg::Graph<N, E>::Node::GetWeights(const N& dest, bool exhaustive) const {
   std::vector<E> v;
 
-  auto itr =
-      std::find_if(edges_out_.begin(), edges_out_.end(),
-                   [&dest](std::pair<std::weak_ptr<Node>, std::set<E, Comparator<E>>> const& p) {
-                     std::shared_ptr<Node> n = p.first.lock();
-                     return n && n->GetValue() == dest;
-                   });
+  auto itr = FindEdgeIn(edges_out_, dest, exhaustive);
 
   if (itr != edges_out_.end()) {
     v.reserve(itr->second.size());
@@ -707,16 +3762,41 @@ std::vector<E> gdwg::Graph<N, E>::Node::GetWeights(const N& dest) const {
     Gets all node destination and connection weight pairs
 */
 template <typename N, typename E>
-std::vector<
-    std::pair<std::weak_ptr<typename gdwg::Graph<N, E>::Node>, std::set<E, gdwg::Comparator<E>>>>
+std::vector<std::pair<std::weak_ptr<typename gdwg::Graph<N, E>::Node>,
+                      typename gdwg::Graph<N, E>::WeightSet>>
 gdwg::Graph<N, E>::Node::EdgesWeights() const {
-  std::vector<std::pair<std::weak_ptr<Node>, std::set<E, Comparator<E>>>> v;
+  std::vector<std::pair<std::weak_ptr<Node>, WeightSet>> v;
 
   for (auto it = edges_out_.begin(); it != edges_out_.end(); ++it) {
-    std::pair<std::weak_ptr<Node>, std::set<E, Comparator<E>>> p{it->first, it->second};
+    std::pair<std::weak_ptr<Node>, WeightSet> p{it->first, it->second};
     v.push_back(p);
   }
 
   return v;
 }
 
+
+/*
+    Finds the edges to dest in O(log d)
+    a lookup landing on an edge to a deleted node, which compares equal to every value, is
+    retried with a linear scan, as is a miss when exhaustive since the edges may be out of order
+*/
+template <typename N, typename E>
+template <typename M>
+auto gdwg::Graph<N, E>::Node::FindEdgeIn(M& edges, const N& dest, bool exhaustive)
+    -> decltype(std::declval<M&>().begin()) {
+  auto it = edges.find(dest);
+  if (it != edges.end()) {
+    std::shared_ptr<Node> n = it->first.lock();
+    if (n && n->value_ == dest) {
+      return it;
+    }
+  } else if (!exhaustive) {
+    return it;
+  }
+
+  return std::find_if(edges.begin(), edges.end(), [&dest](const auto& p) {
+    std::shared_ptr<Node> n = p.first.lock();
+    return n && n->value_ == dest;
+  });
+}
@@ -0,0 +1,177 @@
+#ifndef ASSIGNMENTS_DG_GRAPH_SHM_H_
+#define ASSIGNMENTS_DG_GRAPH_SHM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assignments/dg/graph.h"
+
+namespace gdwg {
+
+// read only image of a graph published to POSIX shared memory, linked by offsets rather
+// than pointers so every process attached to it reads the same pages without copying them
+// nodes and weights must be trivially copyable, and lookups are binary searches
+template <typename N, typename E>
+class SharedImage {
+  static_assert(std::is_trivially_copyable<N>::value && std::is_trivially_copyable<E>::value,
+                "SharedImage requires trivially copyable nodes and weights");
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "SharedImage requires lock free atomics to share the version");
+
+ public:
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::tuple<N, N, E>;
+    using reference = std::tuple<const N&, const N&, const E&>;
+    using pointer = void;
+    using difference_type = std::ptrdiff_t;
+
+    reference operator*() const;
+    const_iterator& operator++();
+
+    const_iterator operator++(int) {
+      auto tmp{*this};
+      ++(*this);
+      return tmp;
+    }
+
+    friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) {
+      return lhs.weight_ == rhs.weight_;
+    }
+
+    friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) {
+      return !(lhs == rhs);
+    }
+
+   private:
+    friend class SharedImage;
+
+    const_iterator(const SharedImage* image, std::uint64_t weight);
+
+    const SharedImage* image_;
+    std::uint64_t src_ = 0;
+    std::uint64_t edge_ = 0;
+    std::uint64_t weight_;
+  };
+
+  // writes a read only image of g to the shared memory segment name, which must start with
+  // a slash, and makes it the version Attach and Refresh return in one atomic step; readers
+  // keep the version they mapped until they Refresh, and one process at a time may publish
+  // under a name
+  static void Publish(const Graph<N, E>&, const std::string&);
+  static SharedImage Attach(const std::string&);
+  static void Unpublish(const std::string&);
+
+  bool IsNode(const N&) const;
+  bool IsConnected(const N&, const N&) const;
+  std::vector<N> GetNodes() const;
+  std::vector<N> GetConnected(const N&) const;
+  std::vector<E> GetWeights(const N&, const N&) const;
+
+  // the version mapped, numbered from 1 by each Publish under the same name
+  std::uint64_t Version() const { return version_; }
+  // maps the newest version if one has been published since, which invalidates iterators
+  // and references into this image
+  bool Refresh();
+
+  const_iterator begin() const { return const_iterator{this, 0}; }
+  const_iterator end() const { return const_iterator{this, Header().weight_count}; }
+
+ private:
+  // start of an image written by Publish, whose arrays follow at the byte offsets given here
+  struct ImageHeader {
+    std::uint64_t magic;
+    // the version in the segment's name, checked against the control segment
+    std::uint64_t version;
+    std::uint64_t node_size;
+    std::uint64_t weight_size;
+    std::uint64_t node_count;
+    std::uint64_t edge_count;
+    std::uint64_t weight_count;
+    // node_count nodes in ascending order
+    std::uint64_t nodes;
+    // node_count + 1 indexes into targets, where each node's edges start
+    std::uint64_t edge_offsets;
+    // edge_count indexes into nodes, ascending within each node's edges
+    std::uint64_t targets;
+    // edge_count + 1 indexes into weights, where each edge's weights start
+    std::uint64_t weight_offsets;
+    // weight_count weights, ascending within each edge
+    std::uint64_t weights;
+  };
+
+  // the segment readers look in to find the current image, named name.version
+  struct ImageControl {
+    std::atomic<std::uint64_t> version;
+  };
+
+  // a shared memory segment mapped into this process, unmapped on destruction
+  class Mapping {
+   public:
+    Mapping() = default;
+    Mapping(void* base, std::size_t size) : base_{base}, size_{size} {}
+    Mapping(Mapping&& m) noexcept : base_{m.base_}, size_{m.size_} { m.base_ = nullptr; }
+    Mapping& operator=(Mapping&& m) noexcept {
+      std::swap(base_, m.base_);
+      std::swap(size_, m.size_);
+      return *this;
+    }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+    ~Mapping() {
+      if (base_ != nullptr) {
+        munmap(base_, size_);
+      }
+    }
+
+    char* Data() const { return static_cast<char*>(base_); }
+    std::size_t Size() const { return size_; }
+    explicit operator bool() const { return base_ != nullptr; }
+
+   private:
+    void* base_ = nullptr;
+    std::size_t size_ = 0;
+  };
+
+  static constexpr std::uint64_t kImageMagic = 0x6764776753484d32;  // "gdwgSHM2"
+
+  explicit SharedImage(const std::string& name) : name_{name} {}
+
+  static std::string ImageName(const std::string&, std::uint64_t);
+  static Mapping MapSegment(const std::string&, std::size_t, const std::string&);
+  static void CheckImage(const Mapping&, std::uint64_t, const std::string&);
+
+  const ImageHeader& Header() const {
+    return *reinterpret_cast<const ImageHeader*>(image_.Data());
+  }
+  template <typename T>
+  const T* Array(std::uint64_t offset) const {
+    return reinterpret_cast<const T*>(image_.Data() + offset);
+  }
+  std::uint64_t FindNode(const N&) const;
+  std::pair<const E*, const E*> FindWeights(std::uint64_t, std::uint64_t) const;
+
+  std::string name_;
+  Mapping control_;
+  Mapping image_;
+  std::uint64_t version_ = 0;
+};
+
+}  // namespace gdwg
+
+#include "graph_shm.tpp"
+
+#endif  // ASSIGNMENTS_DG_GRAPH_SHM_H_
@@ -0,0 +1,437 @@
+#include "assignments/dg/graph_shm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+    Writes the graph to a new segment as the sorted nodes, the targets of each node's edges
+    and the weights of each edge, linked by indexes into those arrays, then announces it by
+    bumping the version in the control segment and unlinks the version it replaces
+*/
+template <typename N, typename E>
+void gdwg::SharedImage<N, E>::Publish(const Graph<N, E>& g, const std::string& name) {
+  // a copy sharing these nodes can leave them out of order, and readers search by value
+  typename Graph<N, E>::Adjacency adj = g.BuildAdjacency();
+  const std::size_t n = adj.nodes.size();
+  std::vector<std::size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&adj](std::size_t a, std::size_t b) {
+    return adj.nodes[a]->GetValue() < adj.nodes[b]->GetValue();
+  });
+  std::vector<std::uint64_t> position(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    position[order[i]] = i;
+  }
+
+  ImageHeader header{};
+  header.magic = kImageMagic;
+  header.node_size = sizeof(N);
+  header.weight_size = sizeof(E);
+  header.node_count = n;
+  header.edge_count = adj.targets.size();
+  for (const auto* costs : adj.weights) {
+    header.weight_count += costs->size();
+  }
+  std::size_t size = sizeof(ImageHeader);
+  auto place = [&size](std::size_t count, std::size_t bytes, std::size_t align) {
+    size = (size + align - 1) / align * align;
+    auto offset = size;
+    size += count * bytes;
+    return offset;
+  };
+  constexpr std::size_t kIndex = sizeof(std::uint64_t);
+  header.nodes = place(n, sizeof(N), alignof(N));
+  header.edge_offsets = place(n + 1, kIndex, alignof(std::uint64_t));
+  header.targets = place(header.edge_count, kIndex, alignof(std::uint64_t));
+  header.weight_offsets = place(header.edge_count + 1, kIndex, alignof(std::uint64_t));
+  header.weights = place(header.weight_count, sizeof(E), alignof(E));
+
+  Mapping control = MapSegment(name, sizeof(ImageControl), "SharedImage::Publish");
+  auto& version = reinterpret_cast<ImageControl*>(control.Data())->version;
+  const std::uint64_t previous = version.load(std::memory_order_acquire);
+  header.version = previous + 1;
+  const std::string segment = ImageName(name, header.version);
+  // left behind by a publish that failed part way
+  shm_unlink(segment.c_str());
+  Mapping image = MapSegment(segment, size, "SharedImage::Publish");
+
+  char* base = image.Data();
+  auto write = [base](std::uint64_t offset, std::size_t i, const auto& value) {
+    std::memcpy(base + offset + i * sizeof(value), &value, sizeof(value));
+  };
+  write(0, 0, header);
+  std::uint64_t edge = 0;
+  std::uint64_t weight = 0;
+  std::vector<std::pair<std::uint64_t, const typename Graph<N, E>::WeightSet*>> edges;
+  for (std::size_t i = 0; i < n; ++i) {
+    write(header.nodes, i, adj.nodes[order[i]]->GetValue());
+    write(header.edge_offsets, i, edge);
+    edges.clear();
+    for (auto e = adj.offsets[order[i]]; e < adj.offsets[order[i] + 1]; ++e) {
+      edges.emplace_back(position[adj.targets[e]], adj.weights[e]);
+    }
+    std::sort(edges.begin(), edges.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    for (const auto& [target, costs] : edges) {
+      write(header.targets, edge, target);
+      write(header.weight_offsets, edge, weight);
+      ++edge;
+      for (const auto& cost : *costs) {
+        write(header.weights, weight++, cost);
+      }
+    }
+  }
+  write(header.edge_offsets, n, edge);
+  write(header.weight_offsets, edge, weight);
+
+  version.store(header.version, std::memory_order_release);
+  if (previous != 0) {
+    shm_unlink(ImageName(name, previous).c_str());
+  }
+}
+
+/*
+    Maps the newest image published under name
+*/
+template <typename N, typename E>
+gdwg::SharedImage<N, E> gdwg::SharedImage<N, E>::Attach(const std::string& name) {
+  SharedImage image{name};
+  image.control_ = MapSegment(name, 0, "SharedImage::Attach");
+  if (image.control_ && image.control_.Size() < sizeof(ImageControl)) {
+    throw std::runtime_error("Cannot call SharedImage::Attach on " + name +
+                             " if it is not a graph image's control segment");
+  }
+  if (!image.control_ || !image.Refresh()) {
+    throw std::runtime_error("Cannot call SharedImage::Attach if no graph is published as " + name);
+  }
+  return image;
+}
+
+/*
+    Removes the image published under name, readers keep the version they mapped
+*/
+template <typename N, typename E>
+void gdwg::SharedImage<N, E>::Unpublish(const std::string& name) {
+  Mapping control = MapSegment(name, sizeof(ImageControl), "SharedImage::Unpublish");
+  auto version = reinterpret_cast<ImageControl*>(control.Data())->version.exchange(0);
+  if (version != 0) {
+    shm_unlink(ImageName(name, version).c_str());
+  }
+  shm_unlink(name.c_str());
+}
+
+template <typename N, typename E>
+std::string gdwg::SharedImage<N, E>::ImageName(const std::string& name, std::uint64_t version) {
+  return name + "." + std::to_string(version);
+}
+
+/*
+    Maps the shared memory segment name, creating it with size bytes if size is not 0 and
+    opening it read only otherwise, where an empty mapping means it doesn't exist yet
+*/
+template <typename N, typename E>
+typename gdwg::SharedImage<N, E>::Mapping
+gdwg::SharedImage<N, E>::MapSegment(const std::string& name,
+                                    std::size_t size,
+                                    const std::string& caller) {
+  auto fail = [&name, &caller](int error) {
+    return std::runtime_error("Cannot call " + caller + " on shared memory segment " + name +
+                              ": " + std::strerror(error));
+  };
+
+  const bool create = size != 0;
+  int fd = shm_open(name.c_str(), create ? O_CREAT | O_RDWR : O_RDONLY, 0644);
+  if (fd < 0) {
+    if (!create && errno == ENOENT) {
+      return Mapping{};
+    }
+    throw fail(errno);
+  }
+
+  struct stat st {};
+  if (create ? ftruncate(fd, static_cast<off_t>(size)) != 0 : fstat(fd, &st) != 0) {
+    int error = errno;
+    close(fd);
+    throw fail(error);
+  }
+  if (!create) {
+    size = static_cast<std::size_t>(st.st_size);
+  }
+  // created by a writer which has not sized it yet
+  if (size == 0) {
+    close(fd);
+    return Mapping{};
+  }
+
+  void* base = mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  int error = errno;
+  close(fd);
+  if (base == MAP_FAILED) {
+    throw fail(error);
+  }
+  return Mapping{base, size};
+}
+
+/*
+    Checks that image is a version of this graph type's image whose arrays lie inside the
+    segment and whose indexes stay inside those arrays, reading every index once, so that
+    queries on a truncated or foreign segment throw here rather than read past the mapping
+*/
+template <typename N, typename E>
+void gdwg::SharedImage<N, E>::CheckImage(const Mapping& image,
+                                         std::uint64_t version,
+                                         const std::string& segment) {
+  auto fail = [&segment](const std::string& reason) {
+    return std::runtime_error("Cannot call SharedImage::Refresh on " + segment + " if " +
+                              reason);
+  };
+
+  const std::uint64_t size = image.Size();
+  if (size < sizeof(ImageHeader)) {
+    throw fail("it is smaller than an image header");
+  }
+  ImageHeader header;
+  std::memcpy(&header, image.Data(), sizeof(header));
+  if (header.magic != kImageMagic) {
+    throw fail("it is not a graph image");
+  }
+  if (header.version != version) {
+    throw fail("its version doesn't match the control segment");
+  }
+  if (header.node_size != sizeof(N) || header.weight_size != sizeof(E)) {
+    throw fail("it was published by a graph of other types");
+  }
+
+  // bounding each count by the size first keeps count + 1 from overflowing
+  auto fits = [size](std::uint64_t offset, std::uint64_t count, std::size_t bytes,
+                     std::size_t align) {
+    return offset >= sizeof(ImageHeader) && offset % align == 0 && offset <= size &&
+           count <= (size - offset) / bytes;
+  };
+  constexpr std::size_t kIndex = sizeof(std::uint64_t);
+  if (header.node_count >= size || header.edge_count >= size ||
+      !fits(header.nodes, header.node_count, sizeof(N), alignof(N)) ||
+      !fits(header.edge_offsets, header.node_count + 1, kIndex, alignof(std::uint64_t)) ||
+      !fits(header.targets, header.edge_count, kIndex, alignof(std::uint64_t)) ||
+      !fits(header.weight_offsets, header.edge_count + 1, kIndex, alignof(std::uint64_t)) ||
+      !fits(header.weights, header.weight_count, sizeof(E), alignof(E))) {
+    throw fail("its arrays don't fit in the segment");
+  }
+
+  auto index = [&image](std::uint64_t offset) {
+    return reinterpret_cast<const std::uint64_t*>(image.Data() + offset);
+  };
+  const auto* edge_offsets = index(header.edge_offsets);
+  const auto* targets = index(header.targets);
+  const auto* weight_offsets = index(header.weight_offsets);
+  if (edge_offsets[0] != 0 || edge_offsets[header.node_count] != header.edge_count ||
+      weight_offsets[0] != 0 || weight_offsets[header.edge_count] != header.weight_count) {
+    throw fail("its offsets don't span its arrays");
+  }
+  // ascending offsets with the ends checked above stay inside targets and weights, and the
+  // iterator relies on every edge having at least one weight
+  for (std::uint64_t i = 0; i < header.node_count; ++i) {
+    if (edge_offsets[i] > edge_offsets[i + 1]) {
+      throw fail("its edge offsets are out of order");
+    }
+  }
+  for (std::uint64_t e = 0; e < header.edge_count; ++e) {
+    if (weight_offsets[e] >= weight_offsets[e + 1]) {
+      throw fail("its weight offsets are out of order");
+    }
+  }
+  for (std::uint64_t i = 0; i < header.node_count; ++i) {
+    for (auto e = edge_offsets[i]; e < edge_offsets[i + 1]; ++e) {
+      if (targets[e] >= header.node_count ||
+          (e > edge_offsets[i] && targets[e - 1] >= targets[e])) {
+        throw fail("its edge targets are out of range or order");
+      }
+    }
+  }
+}
+
+/*
+    Maps the version announced in the control segment if it isn't the one mapped already
+*/
+template <typename N, typename E>
+bool gdwg::SharedImage<N, E>::Refresh() {
+  const auto& version = reinterpret_cast<const ImageControl*>(control_.Data())->version;
+  for (auto current = version.load(std::memory_order_acquire); current != version_;) {
+    // unpublished, the version mapped already stays readable
+    if (current == 0) {
+      return false;
+    }
+
+    const std::string segment = ImageName(name_, current);
+    Mapping image = MapSegment(segment, 0, "SharedImage::Refresh");
+    if (!image) {
+      // replaced and unlinked between reading the version and opening it
+      auto next = version.load(std::memory_order_acquire);
+      if (next == current) {
+        throw std::runtime_error("Cannot call SharedImage::Refresh if the published image " +
+                                 segment + " has been removed");
+      }
+      current = next;
+      continue;
+    }
+
+    CheckImage(image, current, segment);
+    image_ = std::move(image);
+    version_ = current;
+    return true;
+  }
+  return false;
+}
+
+/*
+    Position of val in the sorted nodes by binary search, or the node count if it is missing
+*/
+template <typename N, typename E>
+std::uint64_t gdwg::SharedImage<N, E>::FindNode(const N& val) const {
+  const auto& header = Header();
+  const N* nodes = Array<N>(header.nodes);
+  const N* it = std::lower_bound(nodes, nodes + header.node_count, val);
+  if (it == nodes + header.node_count || val < *it) {
+    return header.node_count;
+  }
+  return static_cast<std::uint64_t>(it - nodes);
+}
+
+/*
+    Weights of the edge between the nodes at src and dst, found by binary search over the
+    targets of src, empty if there is no such edge
+*/
+template <typename N, typename E>
+std::pair<const E*, const E*>
+gdwg::SharedImage<N, E>::FindWeights(std::uint64_t src, std::uint64_t dst) const {
+  const auto& header = Header();
+  const auto* edge_offsets = Array<std::uint64_t>(header.edge_offsets);
+  const auto* targets = Array<std::uint64_t>(header.targets);
+  const auto* first = targets + edge_offsets[src];
+  const auto* last = targets + edge_offsets[src + 1];
+  const auto* it = std::lower_bound(first, last, dst);
+  if (it == last || *it != dst) {
+    return {nullptr, nullptr};
+  }
+
+  const auto* weight_offsets = Array<std::uint64_t>(header.weight_offsets);
+  const E* weights = Array<E>(header.weights);
+  auto edge = it - targets;
+  return {weights + weight_offsets[edge], weights + weight_offsets[edge + 1]};
+}
+
+template <typename N, typename E>
+bool gdwg::SharedImage<N, E>::IsNode(const N& val) const {
+  return FindNode(val) != Header().node_count;
+}
+
+template <typename N, typename E>
+bool gdwg::SharedImage<N, E>::IsConnected(const N& src, const N& dst) const {
+  auto src_at = FindNode(src);
+  auto dst_at = FindNode(dst);
+  if (src_at == Header().node_count || dst_at == Header().node_count) {
+    throw std::runtime_error(
+        "Cannot call SharedImage::IsConnected if src or dst node don't exist in the image");
+  }
+
+  auto [first, last] = FindWeights(src_at, dst_at);
+  return first != last;
+}
+
+template <typename N, typename E>
+std::vector<N> gdwg::SharedImage<N, E>::GetNodes() const {
+  const N* nodes = Array<N>(Header().nodes);
+  return std::vector<N>(nodes, nodes + Header().node_count);
+}
+
+template <typename N, typename E>
+std::vector<N> gdwg::SharedImage<N, E>::GetConnected(const N& src) const {
+  const auto& header = Header();
+  auto src_at = FindNode(src);
+  if (src_at == header.node_count) {
+    throw std::out_of_range(
+        "Cannot call SharedImage::GetConnected if src doesn't exist in the image");
+  }
+
+  const N* nodes = Array<N>(header.nodes);
+  const auto* edge_offsets = Array<std::uint64_t>(header.edge_offsets);
+  const auto* targets = Array<std::uint64_t>(header.targets);
+  std::vector<N> v;
+  v.reserve(edge_offsets[src_at + 1] - edge_offsets[src_at]);
+  for (auto e = edge_offsets[src_at]; e < edge_offsets[src_at + 1]; ++e) {
+    v.push_back(nodes[targets[e]]);
+  }
+  return v;
+}
+
+template <typename N, typename E>
+std::vector<E> gdwg::SharedImage<N, E>::GetWeights(const N& src, const N& dst) const {
+  auto src_at = FindNode(src);
+  auto dst_at = FindNode(dst);
+  if (src_at == Header().node_count || dst_at == Header().node_count) {
+    throw std::out_of_range(
+        "Cannot call SharedImage::GetWeights if src or dst node don't exist in the image");
+  }
+
+  auto [first, last] = FindWeights(src_at, dst_at);
+  return std::vector<E>(first, last);
+}
+
+template <typename N, typename E>
+gdwg::SharedImage<N, E>::const_iterator::const_iterator(const SharedImage* image,
+                                                        std::uint64_t weight)
+  : image_{image}, weight_{weight} {
+  const auto& header = image_->Header();
+  if (weight_ == header.weight_count) {
+    return;
+  }
+
+  // every edge has at least one weight, but a node may have no edges
+  const auto* edge_offsets = image_->template Array<std::uint64_t>(header.edge_offsets);
+  const auto* weight_offsets = image_->template Array<std::uint64_t>(header.weight_offsets);
+  while (weight_offsets[edge_ + 1] <= weight_) {
+    ++edge_;
+  }
+  while (edge_offsets[src_ + 1] <= edge_) {
+    ++src_;
+  }
+}
+
+template <typename N, typename E>
+typename gdwg::SharedImage<N, E>::const_iterator::reference
+gdwg::SharedImage<N, E>::const_iterator::operator*() const {
+  const auto& header = image_->Header();
+  const N* nodes = image_->template Array<N>(header.nodes);
+  const auto* targets = image_->template Array<std::uint64_t>(header.targets);
+  return {nodes[src_], nodes[targets[edge_]], image_->template Array<E>(header.weights)[weight_]};
+}
+
+template <typename N, typename E>
+typename gdwg::SharedImage<N, E>::const_iterator&
+gdwg::SharedImage<N, E>::const_iterator::operator++() {
+  const auto& header = image_->Header();
+  const auto* edge_offsets = image_->template Array<std::uint64_t>(header.edge_offsets);
+  const auto* weight_offsets = image_->template Array<std::uint64_t>(header.weight_offsets);
+  ++weight_;
+  if (weight_ < header.weight_count && weight_ == weight_offsets[edge_ + 1]) {
+    ++edge_;
+    while (edge_offsets[src_ + 1] <= edge_) {
+      ++src_;
+    }
+  }
+  return *this;
+}
@@ -16,9 +16,20 @@
 
  */
 #include "assignments/dg/graph.h"
+#include "assignments/dg/graph_shm.h"
 
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <set>
 #include <utility>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "catch.h"
 
 SCENARIO("Constructors") {
@@ -351,6 +362,45 @@ SCENARIO("Replace") {
       }
     }
   }
+
+  GIVEN("a node with a self loop and an edge to a node deleted while the graph was shared") {
+    gdwg::Graph<int, int> g{6, 7};
+    g.InsertEdge(6, 7, 1);
+    g.InsertEdge(6, 6, 2);
+    {
+      auto copy{g};
+      g.DeleteNode(7);
+    }
+
+    WHEN("the node is replaced after the copy is gone") {
+      g.Replace(6, 5);
+
+      THEN("the self loop moves to the new value") {
+        REQUIRE(g.IsConnected(5, 5));
+        REQUIRE(g.EdgeCount() == 1);
+        REQUIRE(std::vector<std::tuple<int, int, int>>(g.begin(), g.end()) ==
+                std::vector<std::tuple<int, int, int>>{{5, 5, 2}});
+      }
+    }
+  }
+
+  GIVEN("a copy that deletes the same node while the nodes are still shared") {
+    gdwg::Graph<int, int> g{6, 7};
+    g.InsertEdge(6, 7, 1);
+    g.InsertEdge(6, 6, 2);
+    auto copy{g};
+    g.DeleteNode(7);
+    copy.DeleteNode(7);
+
+    WHEN("the node is replaced") {
+      g.Replace(6, 5);
+
+      THEN("both graphs keep the self loop under the new value") {
+        REQUIRE(g.GetWeights(5, 5) == std::vector<int>{2});
+        REQUIRE(copy.GetWeights(5, 5) == std::vector<int>{2});
+      }
+    }
+  }
 }
 
 SCENARIO("MergeReplace") {
@@ -498,6 +548,57 @@ SCENARIO("erase") {
           THEN("the end iterator is returned") { REQUIRE(end == g.end()); }
         }
       }
+
+      WHEN("erasing the first of several weights between the same nodes") {
+        auto itr = g.erase(g.cbegin());
+
+        THEN("the iterator to the next weight is returned") {
+          REQUIRE(*itr == std::make_tuple("A", "B", 4));
+          REQUIRE(g.GetWeights("A", "B") == std::vector<int>{4});
+        }
+      }
+    }
+
+    WHEN("erasing with references taken from an edge iterator") {
+      g.EnableJournal();
+      g.EnableWeightIndex();
+      auto synced = g.JournalSequence();
+      gdwg::Graph<std::string, int> replica{"A", "B"};
+      replica.InsertEdge("A", "B", 2);
+      replica.InsertEdge("B", "A", 9);
+      replica.InsertEdge("A", "B", 4);
+      auto [src, dest, w] = *g.begin();
+      g.erase(src, dest, w);
+      replica.ApplyDelta(g.Delta(synced));
+
+      gdwg::Graph<std::string, int> expected{"A", "B"};
+      expected.InsertEdge("A", "B", 4);
+      expected.InsertEdge("B", "A", 9);
+
+      THEN("the erased weight is the one hashed, indexed and recorded") {
+        REQUIRE(g == expected);
+        REQUIRE(g.ContentHash() == expected.ContentHash());
+        REQUIRE(g.TopKEdges(3) == std::vector<std::tuple<std::string, std::string, int>>{
+                                      {"B", "A", 9}, {"A", "B", 4}});
+        REQUIRE(replica == expected);
+      }
+    }
+  }
+
+  GIVEN("a graph with weights stored in their own allocations") {
+    gdwg::Graph<std::string, std::string> g{"A", "B"};
+    g.InsertEdge("A", "B", "a long weight kept on the heap");
+    g.InsertEdge("A", "B", "another long weight kept on the heap");
+
+    WHEN("erasing every edge with references taken from an edge iterator") {
+      while (g.begin() != g.end()) {
+        auto [src, dest, w] = *g.begin();
+        REQUIRE(g.erase(src, dest, w));
+      }
+
+      THEN("the graph hashes the same as one without the edges") {
+        REQUIRE(g.ContentHash() == gdwg::Graph<std::string, std::string>{"A", "B"}.ContentHash());
+      }
     }
   }
 }
@@ -840,3 +941,1591 @@ SCENARIO("deleting edges and nodes then iterating graph") {
   }
 }
 
+
+SCENARIO("visiting every edge") {
+  GIVEN("a graph with edges") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("A", "B", 2);
+    g.InsertEdge("A", "C", 3);
+    g.InsertEdge("C", "A", 4);
+    g.InsertEdge("D", "D", 5);
+    g.InsertEdge("D", "A", 6);
+
+    WHEN("visiting edges sequentially") {
+      std::vector<std::tuple<std::string, std::string, int>> edges;
+      g.ForEachEdge([&edges](const std::string& src, const std::string& dst, const int& w) {
+        edges.emplace_back(src, dst, w);
+      });
+
+      THEN("the edges are visited in the same order as the iterator") {
+        std::vector<std::tuple<std::string, std::string, int>> expected;
+        for (const auto& [src, dst, w] : g) {
+          expected.emplace_back(src, dst, w);
+        }
+        REQUIRE(edges == expected);
+      }
+    }
+
+    WHEN("visiting edges in parallel") {
+      std::atomic<int> sum{0};
+      g.ParallelForEachEdge([&sum](const std::string&, const std::string&, const int& w) {
+        sum += w;
+      }, 3);
+
+      THEN("every edge is visited once") { REQUIRE(sum == 21); }
+    }
+
+    WHEN("visiting edges in parallel with a functor that counts its calls") {
+      struct Counter {
+        std::atomic<int> calls{0};
+        void operator()(const std::string&, const std::string&, const int&) { ++calls; }
+      };
+      Counter counter;
+      g.ParallelForEachEdge(counter, 3);
+
+      THEN("the caller's functor sees every call") { REQUIRE(counter.calls == 6); }
+    }
+
+    WHEN("reducing over the edges in parallel") {
+      auto degrees = g.ParallelReduceEdges(
+          std::map<std::string, int>{},
+          [](std::map<std::string, int>& acc, const std::string& src, const std::string&,
+             const int&) { ++acc[src]; },
+          [](std::map<std::string, int> acc, std::map<std::string, int> part) {
+            for (const auto& [node, count] : part) {
+              acc[node] += count;
+            }
+            return acc;
+          },
+          4);
+
+      THEN("the partial results are combined") {
+        REQUIRE(degrees == std::map<std::string, int>{{"A", 3}, {"C", 1}, {"D", 2}});
+      }
+    }
+
+    WHEN("reducing from a non-zero initial value with different numbers of threads") {
+      std::vector<int> totals;
+      for (unsigned int threads : {1u, 2u, 4u, 8u}) {
+        totals.push_back(g.ParallelReduceEdges(
+            100,
+            [](int& acc, const std::string&, const std::string&, const int&) { ++acc; },
+            [](int a, int b) { return a + b; }, threads));
+      }
+
+      THEN("the initial value is counted once") {
+        REQUIRE(totals == std::vector<int>{106, 106, 106, 106});
+      }
+    }
+
+    WHEN("a node is deleted before reducing") {
+      g.DeleteNode("B");
+      int total = g.ParallelReduceEdges(0, [](int& acc, const std::string&, const std::string&,
+                                              const int& w) { acc += w; },
+                                        [](int a, int b) { return a + b; }, 2);
+
+      THEN("edges to the deleted node are skipped") { REQUIRE(total == 18); }
+    }
+  }
+}
+
+SCENARIO("topological ordering") {
+  GIVEN("a graph without cycles") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D", "E"};
+    g.InsertEdge("A", "C", 1);
+    g.InsertEdge("B", "C", 1);
+    g.InsertEdge("C", "D", 1);
+    g.InsertEdge("E", "A", 1);
+
+    auto before = [&g](const std::string& a, const std::string& b) {
+      auto order = g.TopologicalOrder();
+      return std::find(order.begin(), order.end(), a) < std::find(order.begin(), order.end(), b);
+    };
+
+    WHEN("getting the topological order") {
+      auto order = g.TopologicalOrder();
+
+      THEN("every node appears once and every edge points forwards") {
+        REQUIRE(order.size() == 5);
+        REQUIRE(before("E", "A"));
+        REQUIRE(before("A", "C"));
+        REQUIRE(before("B", "C"));
+        REQUIRE(before("C", "D"));
+      }
+
+      THEN("there is no cycle") {
+        REQUIRE(g.IsAcyclic());
+        REQUIRE(g.FindCycle().empty());
+      }
+    }
+
+    WHEN("edges and nodes are added after the order is computed") {
+      g.TopologicalOrder();
+      g.InsertNode("F");
+      g.InsertEdge("B", "E", 1);
+      g.InsertEdge("F", "B", 1);
+
+      THEN("the maintained order still has every edge pointing forwards") {
+        REQUIRE(g.TopologicalOrder().size() == 6);
+        REQUIRE(before("F", "B"));
+        REQUIRE(before("B", "E"));
+        REQUIRE(before("E", "A"));
+        REQUIRE(before("A", "C"));
+        REQUIRE(before("C", "D"));
+      }
+    }
+
+    WHEN("a copy sharing the nodes inserts an edge closing a cycle") {
+      g.TopologicalOrder();
+      gdwg::Graph<std::string, int> copy{g};
+      copy.InsertEdge("D", "E", 1);
+
+      THEN("the original sees the cycle too") {
+        REQUIRE(!g.IsAcyclic());
+        REQUIRE_THROWS_WITH(g.TopologicalOrder(),
+                            "Cannot call Graph::TopologicalOrder on a graph with a cycle");
+        REQUIRE(g.FindCycle() == std::vector<std::string>{"A", "C", "D", "E"});
+      }
+    }
+
+    WHEN("an edge closing a cycle is inserted") {
+      g.TopologicalOrder();
+      g.InsertEdge("D", "E", 1);
+
+      THEN("the cycle is reported") {
+        REQUIRE(!g.IsAcyclic());
+        REQUIRE_THROWS_WITH(g.TopologicalOrder(),
+                            "Cannot call Graph::TopologicalOrder on a graph with a cycle");
+        REQUIRE(g.FindCycle() == std::vector<std::string>{"A", "C", "D", "E"});
+      }
+
+      AND_WHEN("the edge is erased again") {
+        g.erase("D", "E", 1);
+
+        THEN("the graph is acyclic") { REQUIRE(g.IsAcyclic()); }
+      }
+
+      AND_WHEN("a node on the cycle is deleted") {
+        g.DeleteNode("C");
+
+        THEN("the order skips the deleted node") {
+          REQUIRE(g.TopologicalOrder().size() == 4);
+          REQUIRE(before("D", "E"));
+          REQUIRE(before("E", "A"));
+        }
+      }
+    }
+  }
+
+  GIVEN("a node with an edge to itself") {
+    gdwg::Graph<int, int> g{1, 2};
+    g.InsertEdge(1, 2, 0);
+    g.InsertEdge(2, 2, 0);
+
+    THEN("the self loop is a cycle") { REQUIRE(g.FindCycle() == std::vector<int>{2}); }
+  }
+}
+
+SCENARIO("strongly connected components") {
+  GIVEN("a graph with cycles") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D", "E", "F"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("B", "C", 2);
+    g.InsertEdge("C", "A", 3);
+    g.InsertEdge("C", "D", 4);
+    g.InsertEdge("D", "E", 5);
+    g.InsertEdge("E", "D", 6);
+    g.InsertEdge("B", "E", 7);
+
+    WHEN("getting the components") {
+      auto components = g.StronglyConnectedComponents();
+
+      THEN("each cycle forms a component ordered by its smallest node") {
+        REQUIRE(components == std::vector<std::vector<std::string>>{
+                                  {"A", "B", "C"}, {"D", "E"}, {"F"}});
+      }
+
+      THEN("the parallel variant finds the same components") {
+        REQUIRE(g.ParallelStronglyConnectedComponents(4) == components);
+      }
+    }
+
+    WHEN("condensing the graph") {
+      auto c = g.Condensation();
+
+      THEN("each component becomes its smallest node and edges between components are kept") {
+        REQUIRE(c.GetNodes() == std::vector<std::string>{"A", "D", "F"});
+        REQUIRE(c.GetConnected("A") == std::vector<std::string>{"D"});
+        REQUIRE(c.GetWeights("A", "D") == std::vector<int>{4, 7});
+        REQUIRE(c.GetConnected("D").empty());
+        REQUIRE(c.IsAcyclic());
+      }
+    }
+  }
+
+  GIVEN("a graph larger than the sequential cutoff") {
+    std::vector<int> nodes(3000);
+    for (int i = 0; i < 3000; ++i) {
+      nodes[i] = i;
+    }
+    gdwg::Graph<int, int> g{nodes.begin(), nodes.end()};
+    for (int i = 0; i < 3000; ++i) {
+      // rings of ten nodes chained together, every seven rings joined back into one component
+      g.InsertEdge(i, i % 10 == 9 ? i - 9 : i + 1, 1);
+      if (i % 10 == 0 && i + 10 < 3000) {
+        g.InsertEdge(i, i + 10, 1);
+      }
+      if (i % 70 == 0 && i + 60 < 3000) {
+        g.InsertEdge(i + 60, i, 1);
+      }
+    }
+
+    THEN("the parallel variant finds the same components as Tarjan") {
+      auto components = g.StronglyConnectedComponents();
+      REQUIRE(components.size() == 48);
+      REQUIRE(components[0].size() == 70);
+      REQUIRE(g.ParallelStronglyConnectedComponents(4) == components);
+    }
+  }
+}
+
+SCENARIO("batched queries") {
+  GIVEN("a graph with edges") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("A", "B", 2);
+    g.InsertEdge("A", "D", 3);
+    g.InsertEdge("C", "A", 4);
+    std::vector<std::pair<std::string, std::string>> queries{
+        {"C", "A"}, {"A", "D"}, {"A", "C"}, {"B", "A"}, {"A", "B"}, {"A", "D"}};
+
+    WHEN("checking connections in a batch") {
+      auto connected = g.IsConnectedBatch(queries);
+
+      THEN("each query gets the same answer as IsConnected in query order") {
+        REQUIRE(connected == std::vector<bool>{true, true, false, false, true, true});
+        REQUIRE(g.IsConnectedBatch(queries, 3) == connected);
+      }
+    }
+
+    WHEN("getting weights in a batch") {
+      auto batch = g.GetWeightsBatch(queries, 2);
+
+      THEN("the weights of each query are stored contiguously in query order") {
+        REQUIRE(batch.offsets == std::vector<std::size_t>{0, 1, 2, 2, 2, 4, 5});
+        REQUIRE(batch.weights == std::vector<int>{4, 3, 1, 2, 3});
+      }
+    }
+
+    WHEN("a query names a node that does not exist") {
+      queries.emplace_back("A", "Z");
+
+      THEN("the batch throws like the single query") {
+        REQUIRE_THROWS_AS(g.IsConnectedBatch(queries), std::runtime_error);
+        REQUIRE_THROWS_AS(g.GetWeightsBatch(queries, 2), std::out_of_range);
+      }
+    }
+
+    WHEN("the only weight between two nodes is erased") {
+      g.erase("C", "A", 4);
+
+      THEN("the nodes are no longer connected") {
+        REQUIRE(!g.IsConnected("C", "A"));
+        REQUIRE(g.IsConnectedBatch(queries)[0] == false);
+      }
+    }
+
+    WHEN("a node is replaced with a value that sorts elsewhere") {
+      g.Replace("B", "E");
+
+      THEN("nodes and edges are still found and iterated in order") {
+        REQUIRE(g.IsConnected("A", "E"));
+        REQUIRE(g.IsConnected("A", "D"));
+        std::vector<std::tuple<std::string, std::string, int>> edges;
+        for (const auto& [src, dst, w] : g) {
+          edges.emplace_back(src, dst, w);
+        }
+        REQUIRE(edges == std::vector<std::tuple<std::string, std::string, int>>{
+                             {"A", "D", 3}, {"A", "E", 1}, {"A", "E", 2}, {"C", "A", 4}});
+      }
+    }
+  }
+}
+
+SCENARIO("viewing nodes, neighbours and weights in place") {
+  GIVEN("a graph with edges") {
+    gdwg::Graph<std::string, int> g{"C", "A", "D", "B"};
+    g.InsertEdge("A", "D", 3);
+    g.InsertEdge("A", "B", 7);
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("C", "A", 4);
+
+    WHEN("viewing the nodes") {
+      std::vector<std::string> nodes;
+      for (const auto& n : g.Nodes()) {
+        nodes.push_back(n);
+      }
+
+      THEN("they are visited in ascending order") { REQUIRE(nodes == g.GetNodes()); }
+    }
+
+    WHEN("viewing the neighbours of a node") {
+      auto neighbors = g.Neighbors("A");
+
+      THEN("the destinations are visited in ascending order") {
+        REQUIRE(std::vector<std::string>(neighbors.begin(), neighbors.end()) ==
+                g.GetConnected("A"));
+        REQUIRE(g.Neighbors("B").empty());
+      }
+
+      THEN("a node that does not exist throws") {
+        REQUIRE_THROWS_AS(g.Neighbors("Z"), std::out_of_range);
+      }
+    }
+
+    WHEN("viewing the weights between two nodes") {
+      auto weights = g.Weights("A", "B");
+
+      THEN("the weights are visited in ascending order") {
+        REQUIRE(std::vector<int>(weights.begin(), weights.end()) == std::vector<int>{1, 7});
+        REQUIRE(g.Weights("B", "A").empty());
+      }
+    }
+
+    WHEN("a destination is deleted") {
+      g.DeleteNode("B");
+
+      THEN("it is skipped by the neighbour view") {
+        auto neighbors = g.Neighbors("A");
+        REQUIRE(std::vector<std::string>(neighbors.begin(), neighbors.end()) ==
+                std::vector<std::string>{"D"});
+      }
+    }
+  }
+}
+
+SCENARIO("iterators across a new weight on an existing edge") {
+  GIVEN("weights small enough to be kept in a sorted vector") {
+    gdwg::Graph<std::string, int> g{"A", "B"};
+    g.InsertEdge("A", "B", 1);
+
+    THEN("they are kept in a FlatSet") {
+      REQUIRE(std::is_same<gdwg::Graph<std::string, int>::WeightSet, gdwg::FlatSet<int>>::value);
+    }
+
+    WHEN("another weight is inserted on the edge") {
+      g.InsertEdge("A", "B", 0);
+
+      THEN("iterators and views taken after the insert see both weights in order") {
+        auto weights = g.Weights("A", "B");
+        REQUIRE(std::vector<int>(weights.begin(), weights.end()) == std::vector<int>{0, 1});
+        REQUIRE(*g.begin() == std::make_tuple("A", "B", 0));
+      }
+    }
+  }
+
+  GIVEN("weights kept in a std::set") {
+    gdwg::Graph<std::string, std::string> g{"A", "B"};
+    g.InsertEdge("A", "B", "x");
+    auto it = g.find("A", "B", "x");
+
+    THEN("they are kept in a std::set") {
+      REQUIRE(std::is_same<gdwg::Graph<std::string, std::string>::WeightSet,
+                           std::set<std::string, gdwg::Comparator<std::string>>>::value);
+    }
+
+    WHEN("another weight is inserted on the edge") {
+      g.InsertEdge("A", "B", "y");
+
+      THEN("an iterator taken before the insert stays valid") {
+        REQUIRE(*it == std::make_tuple("A", "B", "x"));
+        REQUIRE(*++it == std::make_tuple("A", "B", "y"));
+        REQUIRE(++it == g.end());
+      }
+    }
+  }
+}
+
+// a node type with no Serializer, so graphs of it can't keep a journal
+struct Key {
+  std::string s;
+};
+
+bool operator<(const Key& lhs, const Key& rhs) {
+  return lhs.s < rhs.s;
+}
+
+bool operator==(const Key& lhs, const Key& rhs) {
+  return lhs.s == rhs.s;
+}
+
+SCENARIO("replaying mutations from a journal") {
+  GIVEN("a graph recording its mutations") {
+    gdwg::Graph<std::string, double> g;
+    g.EnableJournal();
+    g.InsertNode("A");
+    g.InsertNode("B");
+    g.InsertNode("C");
+    g.InsertEdge("A", "B", 1.5);
+    g.InsertEdge("B", "C", 2.5);
+    g.InsertEdge("C", "A", 3.5);
+
+    gdwg::Graph<std::string, double> replica;
+    replica.ApplyDelta(g.Delta(0));
+    auto synced = g.JournalSequence();
+
+    WHEN("the delta is applied to an empty graph") {
+      THEN("the graphs have the same nodes and edges") {
+        REQUIRE(synced == 6);
+        REQUIRE(replica.GetNodes() == g.GetNodes());
+        REQUIRE(replica.GetWeights("C", "A") == std::vector<double>{3.5});
+      }
+    }
+
+    WHEN("more mutations are made and only the new records are applied") {
+      g.erase("A", "B", 1.5);
+      g.Replace("B", "D");
+      g.MergeReplace("C", "A");
+      g.InsertNode("A");
+      replica.ApplyDelta(g.Delta(synced));
+
+      THEN("the replica catches up") {
+        REQUIRE(g.JournalSequence() == 9);
+        REQUIRE(replica.GetNodes() == std::vector<std::string>{"A", "D"});
+        REQUIRE(!replica.IsConnected("A", "D"));
+        REQUIRE(replica.GetWeights("D", "A") == std::vector<double>{2.5});
+        REQUIRE(replica.GetWeights("A", "A") == std::vector<double>{3.5});
+      }
+    }
+
+    WHEN("the graph is cleared and a node deleted") {
+      g.DeleteNode("A");
+      g.Clear();
+      replica.ApplyDelta(g.Delta(synced));
+
+      THEN("the replica is cleared") { REQUIRE(replica.GetNodes().empty()); }
+    }
+
+    WHEN("another graph is copy assigned to the graph") {
+      gdwg::Graph<std::string, double> other{"X", "Y"};
+      other.InsertEdge("X", "Y", 4.5);
+      g = other;
+      replica.ApplyDelta(g.Delta(synced));
+
+      THEN("the replica ends up with the assigned graph") { REQUIRE(replica == other); }
+    }
+
+    WHEN("another graph is move assigned to the graph") {
+      gdwg::Graph<std::string, double> other{"X", "Y"};
+      g = std::move(other);
+
+      THEN("records from before the assignment are no longer available") {
+        REQUIRE_THROWS_AS(g.Delta(synced), std::out_of_range);
+        REQUIRE(g.Delta(g.JournalSequence()).empty());
+      }
+
+      AND_WHEN("the graph is changed again") {
+        auto restarted = g.JournalSequence();
+        g.InsertEdge("X", "Y", 4.5);
+        gdwg::Graph<std::string, double> fresh{"X", "Y"};
+        fresh.ApplyDelta(g.Delta(restarted));
+
+        THEN("the journal records the changes made after it") {
+          REQUIRE(fresh.GetWeights("X", "Y") == std::vector<double>{4.5});
+        }
+      }
+    }
+  }
+
+  GIVEN("a journal with a capacity") {
+    gdwg::Graph<int, int> g;
+    g.EnableJournal(40);
+    for (int i = 0; i < 10; ++i) {
+      g.InsertNode(i);
+    }
+
+    THEN("the oldest records are dropped") {
+      REQUIRE(g.JournalSequence() == 10);
+      REQUIRE_THROWS_AS(g.Delta(0), std::out_of_range);
+      REQUIRE(g.Delta(2).size() == 40);
+    }
+
+    WHEN("the newest records are applied to a graph holding the older nodes") {
+      gdwg::Graph<int, int> replica{0, 1, 2, 3, 4, 5, 6, 7};
+      replica.ApplyDelta(g.Delta(8));
+
+      THEN("the replica has every node") { REQUIRE(replica.GetNodes() == g.GetNodes()); }
+    }
+  }
+
+  GIVEN("a graph whose nodes and weights have no Serializer") {
+    gdwg::Graph<Key, std::vector<int>> g{Key{"A"}, Key{"B"}};
+
+    WHEN("it is mutated without a journal") {
+      g.InsertEdge(Key{"A"}, Key{"B"}, {1, 2});
+      g.InsertNode(Key{"C"});
+      g.Replace(Key{"C"}, Key{"D"});
+      g.MergeReplace(Key{"D"}, Key{"B"});
+      g.erase(Key{"A"}, Key{"B"}, {1, 2});
+      g.InsertEdge(Key{"B"}, Key{"A"}, {3});
+      g.DeleteNode(Key{"A"});
+      gdwg::Graph<Key, std::vector<int>> copy;
+      copy = g;
+      g.Clear();
+
+      THEN("the mutations apply as usual") {
+        REQUIRE(g.GetNodes().empty());
+        REQUIRE(copy.GetNodes() == std::vector<Key>{Key{"B"}});
+      }
+    }
+  }
+}
+
+SCENARIO("equality and content hashing") {
+  GIVEN("two graphs that differ only in one weight") {
+    gdwg::Graph<std::string, int> g1{"A", "B"};
+    gdwg::Graph<std::string, int> g2{"B", "A"};
+    g1.InsertEdge("A", "B", 1);
+    g2.InsertEdge("A", "B", 2);
+
+    THEN("the graphs are unequal and hash differently") {
+      REQUIRE(g1 != g2);
+      REQUIRE(g1.ContentHash() != g2.ContentHash());
+    }
+
+    WHEN("the weights are made the same") {
+      g2.erase("A", "B", 2);
+      g2.InsertEdge("A", "B", 1);
+
+      THEN("the graphs are equal and hash the same") {
+        REQUIRE(g1 == g2);
+        REQUIRE(g1.ContentHash() == g2.ContentHash());
+      }
+    }
+  }
+
+  GIVEN("a graph changed by every kind of mutation") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("B", "C", 2);
+    g.InsertEdge("C", "C", 3);
+    g.InsertEdge("C", "A", 4);
+    g.InsertEdge("D", "A", 5);
+    g.Replace("C", "E");
+    g.MergeReplace("D", "B");
+    g.InsertNode("F");
+    g.DeleteNode("F");
+
+    THEN("it equals and hashes the same as the graph built directly") {
+      gdwg::Graph<std::string, int> expected{"A", "B", "E"};
+      expected.InsertEdge("A", "B", 1);
+      expected.InsertEdge("B", "E", 2);
+      expected.InsertEdge("B", "A", 5);
+      expected.InsertEdge("E", "E", 3);
+      expected.InsertEdge("E", "A", 4);
+
+      REQUIRE(g == expected);
+      REQUIRE(g.ContentHash() == expected.ContentHash());
+    }
+
+    WHEN("the graph is cleared") {
+      g.Clear();
+
+      THEN("it hashes the same as an empty graph") {
+        REQUIRE(g.ContentHash() == gdwg::Graph<std::string, int>{}.ContentHash());
+      }
+    }
+  }
+}
+
+SCENARIO("counting nodes, edges and degrees") {
+  GIVEN("a graph with multiple weights between nodes") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("A", "B", 2);
+    g.InsertEdge("A", "C", 3);
+    g.InsertEdge("C", "A", 4);
+    g.InsertEdge("B", "B", 5);
+
+    THEN("each weight counts as an edge") {
+      REQUIRE(g.NodeCount() == 3);
+      REQUIRE(g.EdgeCount() == 5);
+      REQUIRE(g.OutDegree("A") == 3);
+      REQUIRE(g.InDegree("B") == 3);
+      REQUIRE(g.InDegree("A") == 1);
+    }
+
+    WHEN("an edge is erased") {
+      g.erase("A", "B", 2);
+
+      THEN("the counts drop by one") {
+        REQUIRE(g.EdgeCount() == 4);
+        REQUIRE(g.OutDegree("A") == 2);
+        REQUIRE(g.InDegree("B") == 2);
+      }
+    }
+
+    WHEN("a node is deleted") {
+      g.DeleteNode("B");
+
+      THEN("edges into and out of it are no longer counted") {
+        REQUIRE(g.NodeCount() == 2);
+        REQUIRE(g.EdgeCount() == 2);
+        REQUIRE(g.OutDegree("A") == 1);
+      }
+    }
+
+    WHEN("a node is merged into another") {
+      g.MergeReplace("C", "B");
+
+      THEN("the merged edges are counted once") {
+        REQUIRE(g.EdgeCount() == 5);
+        REQUIRE(g.OutDegree("A") == 3);
+        REQUIRE(g.InDegree("B") == 4);
+        REQUIRE(g.OutDegree("B") == 2);
+        REQUIRE(g.InDegree("A") == 1);
+      }
+    }
+
+    WHEN("the graph is copied") {
+      auto copy{g};
+      copy.InsertEdge("C", "C", 6);
+
+      THEN("both graphs count the shared edge") {
+        REQUIRE(copy.EdgeCount() == 6);
+        REQUIRE(g.EdgeCount() == 6);
+        REQUIRE(g.InDegree("C") == 2);
+      }
+    }
+
+    WHEN("a copy changes the shared nodes and is then destroyed") {
+      {
+        auto copy{g};
+        copy.InsertEdge("C", "C", 6);
+        copy.erase("A", "B", 1);
+        copy.erase("A", "B", 2);
+      }
+      gdwg::Graph<std::string, int> expected{"A", "B", "C"};
+      expected.InsertEdge("A", "C", 3);
+      expected.InsertEdge("C", "A", 4);
+      expected.InsertEdge("B", "B", 5);
+      expected.InsertEdge("C", "C", 6);
+
+      THEN("the counts and hash are brought up to date") {
+        REQUIRE(g.EdgeCount() == 4);
+        REQUIRE(g.OutDegree("A") == 1);
+        REQUIRE(g.InDegree("C") == 2);
+        REQUIRE(g.ContentHash() == expected.ContentHash());
+      }
+
+      THEN("cached paths are used again") {
+        g.ShortestPaths("A", "C", 1);
+        REQUIRE(g.PathCacheSize() == 1);
+      }
+    }
+
+    WHEN("a node is deleted and inserted again while a copy still holds the old one") {
+      auto copy{g};
+      g.DeleteNode("C");
+      g.InsertNode("C");
+      g.InsertEdge("B", "C", 7);
+      std::map<std::string, std::size_t> in;
+      std::map<std::string, std::size_t> out;
+      std::size_t total = 0;
+      for (const auto& [src, dst, w] : g) {
+        ++out[src];
+        ++in[dst];
+        ++total;
+      }
+
+      THEN("the counts agree with iteration, which matches edges by value") {
+        REQUIRE(total == 5);
+        REQUIRE(g.EdgeCount() == total);
+        for (const auto& n : g.GetNodes()) {
+          REQUIRE(g.InDegree(n) == in[n]);
+          REQUIRE(g.OutDegree(n) == out[n]);
+        }
+      }
+
+      THEN("graph algorithms follow the edge to the old node by value too") {
+        auto ego = g.EgoGraph("A", 1);
+        REQUIRE(ego.GetNodes() == std::vector<std::string>{"A", "B", "C"});
+        REQUIRE(ego.GetWeights("A", "C") == std::vector<int>{3});
+      }
+    }
+
+    WHEN("a temporary copy is destroyed without changes") {
+      { auto copy{g}; }
+      g.ShortestPaths("A", "C", 1);
+
+      THEN("the graph is no longer treated as shared") { REQUIRE(g.PathCacheSize() == 1); }
+    }
+
+    THEN("a node that does not exist throws") {
+      REQUIRE_THROWS_AS(g.OutDegree("Z"), std::out_of_range);
+    }
+  }
+}
+
+SCENARIO("aggregating and filtering numeric weights") {
+  GIVEN("a graph with several weights on some edges") {
+    gdwg::Graph<std::string, double> g{"A", "B", "C"};
+    g.InsertEdge("A", "B", 2.5);
+    g.InsertEdge("A", "B", -1);
+    g.InsertEdge("A", "C", 4);
+    g.InsertEdge("A", "C", 3);
+    g.InsertEdge("A", "C", 7);
+    g.InsertEdge("A", "C", 0.5);
+    g.InsertEdge("C", "A", 10);
+
+    THEN("the minimum, maximum and sum of a node's weights are found") {
+      REQUIRE(g.MinWeight("A") == -1);
+      REQUIRE(g.MaxWeight("A") == 7);
+      REQUIRE(g.SumWeights("A") == 16);
+      REQUIRE(g.SumWeights("B") == 0);
+      REQUIRE(g.SumWeights() == 26);
+    }
+
+    THEN("edges are filtered by a predicate in iterator order and by a weight range") {
+      using Edge = std::tuple<std::string, std::string, double>;
+      REQUIRE(g.EdgesWhere([](double w) { return w > 3; }) ==
+              std::vector<Edge>{{"A", "C", 4}, {"A", "C", 7}, {"C", "A", 10}});
+      REQUIRE(g.EdgesInWeightRange(0.5, 3) ==
+              std::vector<Edge>{{"A", "C", 0.5}, {"A", "B", 2.5}, {"A", "C", 3}});
+      REQUIRE(g.EdgesInWeightRange(3, 0.5).empty());
+    }
+
+    WHEN("a destination node is deleted") {
+      g.DeleteNode("C");
+
+      THEN("its edges no longer count") {
+        REQUIRE(g.MaxWeight("A") == 2.5);
+        REQUIRE(g.SumWeights() == 1.5);
+      }
+    }
+
+    THEN("a node without outgoing edges or that does not exist throws") {
+      REQUIRE_THROWS_AS(g.MinWeight("B"), std::runtime_error);
+      REQUIRE_THROWS_AS(g.MaxWeight("Z"), std::out_of_range);
+      REQUIRE_THROWS_AS(g.SumWeights("Z"), std::out_of_range);
+    }
+  }
+}
+
+SCENARIO("walking the graph a few edges at a time") {
+  GIVEN("a graph with several edges") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("A", "B", 2);
+    g.InsertEdge("A", "C", 3);
+    g.InsertEdge("B", "D", 4);
+    g.InsertEdge("C", "A", 5);
+
+    using Edge = std::tuple<std::string, std::string, int>;
+    std::vector<Edge> seen;
+    auto record = [&seen](const std::string& src, const std::string& dst, int w) {
+      seen.emplace_back(src, dst, w);
+    };
+
+    WHEN("the edges are walked two at a time") {
+      auto walk = g.WalkEdges();
+      int steps = 0;
+      while (walk.Step(record, 2)) {
+        ++steps;
+      }
+
+      THEN("every edge is visited once in iterator order") {
+        REQUIRE(steps == 2);
+        REQUIRE(walk.Done());
+        REQUIRE(seen == std::vector<Edge>(g.begin(), g.end()));
+      }
+    }
+
+    WHEN("the graph changes between steps") {
+      auto walk = g.WalkEdges();
+      walk.Step(record, 2);
+      g.InsertEdge("A", "A", 0);
+      g.InsertEdge("A", "B", 9);
+      g.DeleteNode("C");
+      while (walk.Step(record, 2)) {
+      }
+
+      THEN("the walk continues after the last edge it visited") {
+        REQUIRE(seen == std::vector<Edge>{{"A", "B", 1}, {"A", "B", 2}, {"A", "B", 9},
+                                          {"B", "D", 4}});
+      }
+    }
+
+    WHEN("the edges are walked with a step of zero edges") {
+      auto walk = g.WalkEdges();
+      int steps = 0;
+      while (walk.Step(record, 0)) {
+        ++steps;
+      }
+
+      THEN("each step visits one edge and the walk finishes") {
+        REQUIRE(steps == 5);
+        REQUIRE(seen == std::vector<Edge>(g.begin(), g.end()));
+      }
+    }
+
+    WHEN("a copy sharing the nodes renames the last source visited between steps") {
+      auto walk = g.WalkEdges();
+      walk.Step(record, 2);
+      auto copy{g};
+      copy.Replace("A", "E");
+      while (walk.Step(record, 2)) {
+      }
+
+      THEN("the walk resumes after it without repeating its edges") {
+        REQUIRE(seen == std::vector<Edge>{{"A", "B", 1}, {"A", "B", 2}, {"B", "D", 4},
+                                          {"C", "E", 5}});
+      }
+    }
+
+    WHEN("the graph is walked breadth first with a step of zero edges") {
+      std::vector<std::string> order;
+      auto walk = g.WalkBreadthFirst("C");
+      int steps = 0;
+      while (walk.Step([&order](const std::string& n) { order.push_back(n); }, 0)) {
+        ++steps;
+      }
+
+      THEN("the walk finishes as if each step examined one edge") {
+        REQUIRE(order == std::vector<std::string>{"C", "A", "B", "D"});
+        REQUIRE(steps == 3);
+      }
+    }
+
+    WHEN("the graph is walked breadth first one edge at a time") {
+      std::vector<std::string> order;
+      auto walk = g.WalkBreadthFirst("C");
+      int steps = 0;
+      while (walk.Step([&order](const std::string& n) { order.push_back(n); }, 1)) {
+        ++steps;
+      }
+
+      THEN("nodes are visited in breadth first order") {
+        REQUIRE(order == std::vector<std::string>{"C", "A", "B", "D"});
+        REQUIRE(steps == 3);
+        REQUIRE(walk.Done());
+      }
+    }
+
+    THEN("a walk from a node that does not exist throws") {
+      REQUIRE_THROWS_AS(g.WalkBreadthFirst("Z"), std::out_of_range);
+    }
+  }
+}
+
+SCENARIO("ranking nodes with PageRank") {
+  GIVEN("a cycle of three nodes") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("B", "C", 1);
+    g.InsertEdge("C", "A", 1);
+
+    THEN("every node has the same rank") {
+      auto result = g.PageRank();
+      REQUIRE(result.converged);
+      REQUIRE(result.ranks.size() == 3);
+      for (const auto& [node, rank] : result.ranks) {
+        REQUIRE(std::abs(rank - 1.0 / 3) < 1e-9);
+      }
+      REQUIRE(result.residuals.size() == result.iteration_ms.size());
+    }
+  }
+
+  GIVEN("a node pointed to by every other node with weighted edges") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D"};
+    g.InsertEdge("B", "A", 1);
+    g.InsertEdge("C", "A", 1);
+    g.InsertEdge("D", "A", 3);
+    g.InsertEdge("D", "C", 1);
+
+    THEN("it ranks highest and the ranks sum to one") {
+      auto result = g.PageRank();
+      REQUIRE(result.converged);
+      REQUIRE(result.ranks[0].first == "A");
+      double total = 0;
+      for (const auto& [node, rank] : result.ranks) {
+        total += rank;
+        REQUIRE(rank <= result.ranks[0].second);
+      }
+      REQUIRE(std::abs(total - 1) < 1e-6);
+    }
+
+    THEN("weighted ranking favours the heavier edge") {
+      decltype(g)::PageRankOptions options;
+      auto uniform = g.PageRank(options);
+      options.weighted = true;
+      auto weighted = g.PageRank(options);
+      REQUIRE(weighted.ranks[2].second < uniform.ranks[2].second);
+      REQUIRE(weighted.ranks[0].second > uniform.ranks[0].second);
+    }
+
+    THEN("a damping factor outside [0, 1] throws") {
+      decltype(g)::PageRankOptions options;
+      options.damping = 1.5;
+      REQUIRE_THROWS_AS(g.PageRank(options), std::runtime_error);
+    }
+  }
+
+  GIVEN("a graph large enough to rank on several threads") {
+    gdwg::Graph<int, int> g;
+    for (int i = 0; i < 5000; ++i) {
+      g.InsertNode(i);
+    }
+    for (int i = 0; i < 5000; ++i) {
+      g.InsertEdge(i, (i * 7 + 1) % 5000, 1);
+      g.InsertEdge(i, (i * 13 + 5) % 5000, 2);
+    }
+
+    THEN("the ranks match a single threaded run") {
+      decltype(g)::PageRankOptions options;
+      options.num_threads = 1;
+      auto single = g.PageRank(options);
+      options.num_threads = 4;
+      auto parallel = g.PageRank(options);
+      REQUIRE(parallel.converged);
+      double difference = 0;
+      for (std::size_t i = 0; i < single.ranks.size(); ++i) {
+        difference += std::abs(single.ranks[i].second - parallel.ranks[i].second);
+      }
+      REQUIRE(difference < options.tolerance);
+    }
+  }
+}
+
+SCENARIO("finding the k shortest paths") {
+  GIVEN("a graph with several routes between two nodes") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D", "E"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("A", "B", 5);
+    g.InsertEdge("B", "D", 1);
+    g.InsertEdge("A", "C", 2);
+    g.InsertEdge("C", "D", 2);
+    g.InsertEdge("B", "C", 1);
+    g.InsertEdge("A", "D", 6);
+    g.InsertEdge("D", "A", 1);
+
+    using Route = std::pair<std::vector<std::string>, int>;
+    auto routes = [&g](const std::string& src, const std::string& dst, std::size_t k) {
+      std::vector<Route> result;
+      for (const auto& path : g.ShortestPaths(src, dst, k)) {
+        result.emplace_back(path.nodes, path.cost);
+      }
+      return result;
+    };
+
+    THEN("loopless paths are found in ascending cost using the cheapest weight of each hop") {
+      REQUIRE(routes("A", "D", 10) == std::vector<Route>{{{"A", "B", "D"}, 2},
+                                                         {{"A", "B", "C", "D"}, 4},
+                                                         {{"A", "C", "D"}, 4},
+                                                         {{"A", "D"}, 6}});
+      REQUIRE(routes("A", "D", 2).size() == 2);
+      REQUIRE(routes("A", "A", 3) == std::vector<Route>{{{"A"}, 0}});
+      REQUIRE(routes("A", "E", 3).empty());
+      REQUIRE(g.PathCacheSize() == 4);
+    }
+
+    WHEN("an edge no cached path uses is erased") {
+      routes("A", "D", 2);
+      g.erase("A", "D", 6);
+      g.erase("A", "B", 5);
+
+      THEN("the cached result is kept") { REQUIRE(g.PathCacheSize() == 1); }
+    }
+
+    WHEN("the cheapest weight of a hop on a cached path is erased") {
+      routes("A", "D", 1);
+      routes("C", "A", 1);
+      g.erase("A", "B", 1);
+
+      THEN("only the results using that hop are recomputed") {
+        REQUIRE(g.PathCacheSize() == 1);
+        REQUIRE(routes("A", "D", 1) == std::vector<Route>{{{"A", "C", "D"}, 4}});
+      }
+    }
+
+    WHEN("a cheaper edge is inserted") {
+      routes("A", "D", 1);
+      g.InsertEdge("A", "D", 6);
+      REQUIRE(g.PathCacheSize() == 1);
+      g.InsertEdge("A", "D", 1);
+
+      THEN("cached results are recomputed") {
+        REQUIRE(g.PathCacheSize() == 0);
+        REQUIRE(routes("A", "D", 1) == std::vector<Route>{{{"A", "D"}, 1}});
+      }
+    }
+
+    WHEN("cheaper edges are inserted that cached paths could only use at a higher cost") {
+      routes("A", "D", 1);
+      routes("C", "A", 1);
+      g.InsertEdge("E", "A", 1);
+      g.InsertEdge("C", "B", 3);
+      g.InsertEdge("B", "B", 0);
+
+      THEN("the cached results are kept") { REQUIRE(g.PathCacheSize() == 2); }
+
+      AND_WHEN("an edge is inserted that makes one of them cheaper") {
+        g.InsertEdge("C", "A", 1);
+
+        THEN("only that result is recomputed") {
+          REQUIRE(g.PathCacheSize() == 1);
+          REQUIRE(routes("C", "A", 1) == std::vector<Route>{{{"C", "A"}, 1}});
+          REQUIRE(routes("A", "D", 1) == std::vector<Route>{{{"A", "B", "D"}, 2}});
+        }
+      }
+    }
+
+    WHEN("an edge is inserted that joins two nodes with fewer cached paths than asked for") {
+      routes("A", "E", 3);
+      routes("A", "D", 1);
+      g.InsertEdge("D", "E", 4);
+
+      THEN("the incomplete result is recomputed") {
+        REQUIRE(g.PathCacheSize() == 1);
+        REQUIRE(routes("A", "E", 1) == std::vector<Route>{{{"A", "B", "D", "E"}, 6}});
+      }
+    }
+
+    WHEN("a node on a cached path is deleted, or a node is replaced") {
+      routes("A", "D", 1);
+      routes("C", "A", 1);
+      g.DeleteNode("B");
+      REQUIRE(g.PathCacheSize() == 1);
+      g.Replace("E", "F");
+
+      THEN("the affected results are dropped") {
+        REQUIRE(g.PathCacheSize() == 0);
+        REQUIRE(routes("A", "D", 1) == std::vector<Route>{{{"A", "C", "D"}, 4}});
+      }
+    }
+
+    WHEN("the cache capacity is reduced") {
+      routes("A", "D", 1);
+      routes("A", "D", 2);
+      routes("A", "D", 1);
+      g.SetPathCacheCapacity(1);
+      routes("C", "A", 1);
+
+      THEN("the least recently used results are dropped") { REQUIRE(g.PathCacheSize() == 1); }
+    }
+
+    THEN("nodes that do not exist throw") {
+      REQUIRE_THROWS_AS(g.ShortestPaths("A", "Z", 1), std::out_of_range);
+    }
+  }
+
+  GIVEN("a dense graph with many routes of differing cost") {
+    gdwg::Graph<int, int> g{0, 1, 2, 3, 4, 5};
+    for (int src = 0; src < 6; ++src) {
+      for (int dst = 0; dst < 6; ++dst) {
+        if (src != dst && (src * 7 + dst * 3) % 5 != 0) {
+          g.InsertEdge(src, dst, (src * 5 + dst * 11) % 9 + 1);
+        }
+      }
+    }
+
+    // every loopless path from 0 to 5 by depth first search
+    std::vector<int> costs;
+    std::vector<bool> on_path(6, false);
+    std::function<void(int, int)> extend = [&](int node, int cost) {
+      if (node == 5) {
+        costs.push_back(cost);
+        return;
+      }
+      on_path[node] = true;
+      for (const auto& next : g.GetConnected(node)) {
+        if (!on_path[next]) {
+          extend(next, cost + g.GetWeights(node, next).front());
+        }
+      }
+      on_path[node] = false;
+    };
+    extend(0, 0);
+    std::sort(costs.begin(), costs.end());
+
+    WHEN("asking for more paths than there are") {
+      auto paths = g.ShortestPaths(0, 5, costs.size() + 1);
+
+      THEN("every loopless path is found once in ascending cost") {
+        std::vector<int> found;
+        std::set<std::vector<int>> distinct;
+        for (const auto& path : paths) {
+          found.push_back(path.cost);
+          distinct.insert(path.nodes);
+        }
+        REQUIRE(found == costs);
+        REQUIRE(distinct.size() == paths.size());
+      }
+    }
+  }
+}
+
+SCENARIO("extracting subgraphs and filtering views") {
+  GIVEN("a graph with weighted edges") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D", "E"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("A", "B", 7);
+    g.InsertEdge("B", "C", 2);
+    g.InsertEdge("C", "D", 3);
+    g.InsertEdge("D", "A", 4);
+    g.InsertEdge("A", "E", 5);
+    g.InsertEdge("E", "E", 6);
+
+    using Edge = std::tuple<std::string, std::string, int>;
+
+    THEN("an induced subgraph keeps the given nodes and every edge between them") {
+      auto sub = g.InducedSubgraph({"A", "B", "D"});
+      REQUIRE(sub.GetNodes() == std::vector<std::string>{"A", "B", "D"});
+      REQUIRE(std::vector<Edge>(sub.begin(), sub.end()) ==
+              std::vector<Edge>{{"A", "B", 1}, {"A", "B", 7}, {"D", "A", 4}});
+      REQUIRE(sub.EdgeCount() == 3);
+      REQUIRE(sub.InDegree("A") == 1);
+      REQUIRE(sub.ContentHash() == gdwg::Graph<std::string, int>(sub).ContentHash());
+    }
+
+    THEN("an ego graph keeps the nodes within the given number of hops") {
+      REQUIRE(g.EgoGraph("B", 0).GetNodes() == std::vector<std::string>{"B"});
+      auto ego = g.EgoGraph("B", 2);
+      REQUIRE(ego.GetNodes() == std::vector<std::string>{"B", "C", "D"});
+      REQUIRE(ego.EdgeCount() == 2);
+      REQUIRE(g.EgoGraph("B", 4).GetNodes() == g.GetNodes());
+    }
+
+    THEN("a predicate subgraph keeps the matching nodes and weights") {
+      auto sub = g.Subgraph([](const std::string& n) { return n != "C"; },
+                            [](const std::string&, const std::string&, int w) { return w < 6; });
+      REQUIRE(std::vector<Edge>(sub.begin(), sub.end()) ==
+              std::vector<Edge>{{"A", "B", 1}, {"A", "E", 5}, {"D", "A", 4}});
+      REQUIRE(g.Subgraph([](const std::string& n) { return n < "C"; }).EdgeCount() == 2);
+    }
+
+    WHEN("a filtered view is taken") {
+      auto view = g.Filter([](const std::string& n) { return n != "C"; },
+                           [](const std::string&, const std::string&, int w) { return w != 7; });
+
+      THEN("queries and iteration see only the kept nodes and edges") {
+        REQUIRE(view.IsNode("A"));
+        REQUIRE_FALSE(view.IsNode("C"));
+        REQUIRE(view.GetNodes() == std::vector<std::string>{"A", "B", "D", "E"});
+        REQUIRE(view.GetConnected("A") == std::vector<std::string>{"B", "E"});
+        REQUIRE(view.GetWeights("A", "B") == std::vector<int>{1});
+        REQUIRE_FALSE(view.IsConnected("B", "D"));
+        REQUIRE(std::vector<Edge>(view.begin(), view.end()) ==
+                std::vector<Edge>{{"A", "B", 1}, {"A", "E", 5}, {"D", "A", 4}, {"E", "E", 6}});
+        REQUIRE(view.ToGraph().EdgeCount() == 4);
+        REQUIRE_THROWS_AS(view.GetWeights("A", "C"), std::out_of_range);
+      }
+
+      THEN("changes to the graph show through the view") {
+        g.InsertEdge("B", "D", 8);
+        REQUIRE(view.IsConnected("B", "D"));
+      }
+    }
+
+    THEN("nodes that do not exist throw") {
+      REQUIRE_THROWS_AS(g.InducedSubgraph({"A", "Z"}), std::out_of_range);
+      REQUIRE_THROWS_AS(g.EgoGraph("Z", 1), std::out_of_range);
+    }
+  }
+}
+
+SCENARIO("moving values into the graph") {
+  const std::string a(40, 'a');
+  const std::string b(40, 'b');
+
+  GIVEN("a vector of edges to consume") {
+    std::vector<std::tuple<std::string, std::string, std::string>> edges{{a, b, "x"},
+                                                                         {b, a, "y"},
+                                                                         {a, b, "z"}};
+    gdwg::Graph<std::string, std::string> g{std::move(edges)};
+
+    THEN("the graph holds every node and edge") {
+      REQUIRE(g.GetNodes() == std::vector<std::string>{a, b});
+      REQUIRE(g.GetWeights(a, b) == std::vector<std::string>{"x", "z"});
+      REQUIRE(g.EdgeCount() == 3);
+      REQUIRE(g.ContentHash() == gdwg::Graph<std::string, std::string>(g).ContentHash());
+    }
+
+    WHEN("values are moved or emplaced into it") {
+      std::string c(40, 'c');
+      std::string duplicate = a;
+      bool added = g.InsertNode(std::move(c));
+      bool added_again = g.InsertNode(std::move(duplicate));
+      g.EmplaceNode(40, 'd');
+      g.EmplaceEdge(b, std::string(40, 'd'), 3, 'w');
+      std::string renamed(40, 'e');
+      g.Replace(std::string(40, 'c'), std::move(renamed));
+
+      THEN("they are added without a copy and duplicates are left untouched") {
+        REQUIRE(added);
+        REQUIRE_FALSE(added_again);
+        REQUIRE(duplicate == a);
+        REQUIRE(g.IsNode(std::string(40, 'd')));
+        REQUIRE(g.GetWeights(b, std::string(40, 'd')) == std::vector<std::string>{"www"});
+        REQUIRE(g.IsNode(std::string(40, 'e')));
+        REQUIRE(g.NodeCount() == 4);
+      }
+    }
+  }
+
+  GIVEN("a vector of nodes with duplicates to consume") {
+    std::vector<std::string> nodes{b, a, b};
+    gdwg::Graph<std::string, int> g{std::move(nodes)};
+
+    THEN("each node is added once") {
+      REQUIRE(g.GetNodes() == std::vector<std::string>{a, b});
+      REQUIRE(g.NodeCount() == 2);
+    }
+  }
+}
+
+SCENARIO("seeking edge iterators to a source or destination") {
+  GIVEN("a graph with edges from several sources") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D", "E"};
+    g.InsertEdge("A", "B", 1);
+    g.InsertEdge("A", "D", 2);
+    g.InsertEdge("C", "A", 3);
+    g.InsertEdge("C", "C", 4);
+    g.InsertEdge("C", "E", 5);
+    g.InsertEdge("C", "E", 6);
+    g.InsertEdge("E", "A", 7);
+
+    using Edge = std::tuple<std::string, std::string, int>;
+
+    THEN("lower bounds land on the first edge at or after the given source and destination") {
+      REQUIRE(*g.LowerBound("A") == Edge{"A", "B", 1});
+      REQUIRE(*g.LowerBound("B") == Edge{"C", "A", 3});
+      REQUIRE(*g.LowerBound("C", "B") == Edge{"C", "C", 4});
+      REQUIRE(*g.LowerBound("C", "E") == Edge{"C", "E", 5});
+      REQUIRE(*g.LowerBound("C", "F") == Edge{"E", "A", 7});
+      REQUIRE(*g.LowerBound("B", "Z") == Edge{"C", "A", 3});
+      REQUIRE(g.LowerBound("F") == g.end());
+    }
+
+    THEN("iterators from a lower bound move in both directions") {
+      auto it = g.LowerBound("C", "E");
+      REQUIRE(*--it == Edge{"C", "C", 4});
+      REQUIRE(*--it == Edge{"C", "A", 3});
+      REQUIRE(*--it == Edge{"A", "D", 2});
+      REQUIRE(*++it == Edge{"C", "A", 3});
+    }
+
+    THEN("a range of sources is listed in iterator order") {
+      auto edges = g.EdgesFrom("B", "D");
+      REQUIRE(std::vector<Edge>(edges.begin(), edges.end()) ==
+              std::vector<Edge>{{"C", "A", 3}, {"C", "C", 4}, {"C", "E", 5}, {"C", "E", 6}});
+      auto tail = g.EdgesFrom("D", "Z");
+      REQUIRE(std::vector<Edge>(tail.begin(), tail.end()) == std::vector<Edge>{{"E", "A", 7}});
+      REQUIRE(g.EdgesFrom("D", "A").empty());
+    }
+
+    WHEN("a copy sharing the nodes replaces one with a value that sorts first") {
+      auto copy{g};
+      copy.Replace("E", "0");
+
+      THEN("seeking the original still lands on the edges from the replaced node") {
+        REQUIRE(*g.LowerBound("0") == Edge{"0", "A", 7});
+        REQUIRE(*g.LowerBound("C", "0") == Edge{"C", "0", 5});
+        REQUIRE(*g.LowerBound("B") == Edge{"C", "0", 5});
+        auto edges = g.EdgesFrom("0", "0");
+        REQUIRE(std::vector<Edge>(edges.begin(), edges.end()) == std::vector<Edge>{{"0", "A", 7}});
+      }
+    }
+
+    WHEN("a destination is deleted from the graph and a copy sharing its nodes") {
+      auto copy{g};
+      g.DeleteNode("D");
+      copy.DeleteNode("D");
+
+      THEN("iteration skips only the edges to it") {
+        REQUIRE(std::vector<Edge>(g.begin(), g.end()).size() == 6);
+        REQUIRE(*std::next(g.begin()) == Edge{"C", "A", 3});
+        REQUIRE(*std::prev(g.find("C", "A", 3)) == Edge{"A", "B", 1});
+        REQUIRE(*g.rbegin() == Edge{"E", "A", 7});
+      }
+    }
+  }
+}
+
+SCENARIO("tracking weakly connected components") {
+  GIVEN("a graph with component tracking enabled") {
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D"};
+    g.InsertEdge("A", "B", 1);
+    g.EnableComponentTracking();
+
+    THEN("components are counted with edges joining nodes in either direction") {
+      REQUIRE(g.ComponentCount() == 3);
+      REQUIRE(g.SameComponent("B", "A"));
+      REQUIRE_FALSE(g.SameComponent("A", "C"));
+    }
+
+    WHEN("nodes and edges are inserted") {
+      g.InsertNode("E");
+      g.InsertEdge("D", "C", 2);
+      g.InsertEdge("C", "B", 3);
+
+      THEN("the components are joined") {
+        REQUIRE(g.ComponentCount() == 2);
+        REQUIRE(g.SameComponent("A", "D"));
+        REQUIRE_FALSE(g.SameComponent("A", "E"));
+      }
+    }
+
+    WHEN("a node is merged into another") {
+      g.InsertEdge("C", "D", 2);
+      g.MergeReplace("B", "C");
+
+      THEN("the merged components stay joined") {
+        REQUIRE(g.ComponentCount() == 1);
+        REQUIRE(g.SameComponent("A", "D"));
+      }
+    }
+
+    WHEN("the only edge between two nodes is erased or a node is deleted") {
+      g.InsertEdge("A", "B", 2);
+      g.InsertEdge("B", "C", 3);
+      g.erase("A", "B", 1);
+      REQUIRE(g.SameComponent("A", "C"));
+      g.erase("A", "B", 2);
+      REQUIRE_FALSE(g.SameComponent("A", "C"));
+      g.DeleteNode("D");
+
+      THEN("the components are rebuilt on the next query") {
+        REQUIRE(g.ComponentCount() == 2);
+        REQUIRE(g.SameComponent("B", "C"));
+      }
+    }
+
+    WHEN("the graph is cleared") {
+      g.Clear();
+      g.InsertNode("A");
+
+      THEN("tracking continues from the empty graph") { REQUIRE(g.ComponentCount() == 1); }
+    }
+
+    THEN("nodes that do not exist throw") {
+      REQUIRE_THROWS_AS(g.SameComponent("A", "Z"), std::out_of_range);
+    }
+  }
+
+  GIVEN("a graph without component tracking") {
+    gdwg::Graph<std::string, int> g{"A"};
+
+    THEN("component queries throw") { REQUIRE_THROWS_AS(g.ComponentCount(), std::runtime_error); }
+  }
+}
+
+SCENARIO("querying edges by weight through the weight index") {
+  GIVEN("a graph with edges of repeated weights") {
+    using Edge = std::tuple<std::string, std::string, int>;
+    gdwg::Graph<std::string, int> g{"A", "B", "C", "D"};
+    g.InsertEdge("A", "B", 5);
+    g.InsertEdge("A", "C", 2);
+    g.InsertEdge("B", "C", 5);
+    g.InsertEdge("C", "A", 9);
+    g.InsertEdge("D", "D", 1);
+    g.InsertEdge("D", "A", 5);
+
+    THEN("the same edges come back with and without the index") {
+      auto range = g.EdgesInWeightRange(2, 5);
+      auto top = g.TopKEdges(3);
+      REQUIRE(range == std::vector<Edge>{{"A", "C", 2}, {"A", "B", 5}, {"B", "C", 5},
+                                         {"D", "A", 5}});
+      REQUIRE(top == std::vector<Edge>{{"C", "A", 9}, {"D", "A", 5}, {"B", "C", 5}});
+      REQUIRE(g.TopKEdges(0).empty());
+      REQUIRE(g.TopKEdges(10).size() == 6);
+
+      g.EnableWeightIndex();
+      REQUIRE(g.EdgesInWeightRange(2, 5) == range);
+      REQUIRE(g.TopKEdges(3) == top);
+      REQUIRE(g.EdgesInWeightRange(6, 8).empty());
+      REQUIRE(g.EdgesInWeightRange(5, 2).empty());
+    }
+
+    WHEN("the graph is changed with the index enabled") {
+      g.EnableWeightIndex();
+      g.InsertEdge("B", "D", 7);
+      g.erase("A", "B", 5);
+      g.DeleteNode("C");
+      g.Replace("D", "E");
+
+      THEN("the index follows every change") {
+        REQUIRE(g.TopKEdges(10) == std::vector<Edge>{{"B", "E", 7}, {"E", "A", 5},
+                                                     {"E", "E", 1}});
+        REQUIRE(g.EdgesInWeightRange(1, 5) == std::vector<Edge>{{"E", "E", 1},
+                                                                {"E", "A", 5}});
+      }
+
+      AND_WHEN("a node is merged into another and the graph copied") {
+        g.MergeReplace("E", "B");
+        auto merged = g.TopKEdges(10);
+        gdwg::Graph<std::string, int> copy{g};
+        copy.InsertEdge("A", "B", 8);
+
+        THEN("the merged edges are indexed and the copy's edges are seen") {
+          REQUIRE(merged == std::vector<Edge>{{"B", "B", 7}, {"B", "A", 5}, {"B", "B", 1}});
+          REQUIRE(g.TopKEdges(10) == std::vector<Edge>{{"A", "B", 8}, {"B", "B", 7},
+                                                       {"B", "A", 5}, {"B", "B", 1}});
+          REQUIRE(std::vector<Edge>(g.begin(), g.end()).size() == 4);
+        }
+      }
+    }
+
+    WHEN("the graph is cleared") {
+      g.EnableWeightIndex();
+      g.Clear();
+      g.InsertNode("A");
+      g.InsertEdge("A", "A", 3);
+
+      THEN("the index starts again from the new edges") {
+        REQUIRE(g.TopKEdges(2) == std::vector<Edge>{{"A", "A", 3}});
+      }
+    }
+  }
+}
+
+SCENARIO("sharing a read only image of the graph between processes") {
+  GIVEN("a graph published to shared memory") {
+    using Edge = std::tuple<int, int, double>;
+    const std::string name = "/gdwg_test_" + std::to_string(getpid());
+    gdwg::Graph<int, double> g{1, 2, 3, 4};
+    g.InsertEdge(1, 2, 0.5);
+    g.InsertEdge(1, 2, -1);
+    g.InsertEdge(3, 1, 2);
+    g.InsertEdge(1, 4, 7);
+    g.InsertEdge(4, 4, 1);
+    gdwg::SharedImage<int, double>::Publish(g, name);
+    auto image = gdwg::SharedImage<int, double>::Attach(name);
+
+    THEN("the image answers queries and iterates like the graph") {
+      REQUIRE(image.Version() == 1);
+      REQUIRE(image.IsNode(3));
+      REQUIRE_FALSE(image.IsNode(5));
+      REQUIRE(image.IsConnected(1, 2));
+      REQUIRE_FALSE(image.IsConnected(2, 1));
+      REQUIRE(image.GetNodes() == std::vector<int>{1, 2, 3, 4});
+      REQUIRE(image.GetConnected(1) == std::vector<int>{2, 4});
+      REQUIRE(image.GetConnected(2).empty());
+      REQUIRE(image.GetWeights(1, 2) == std::vector<double>{-1, 0.5});
+      REQUIRE(std::vector<Edge>(image.begin(), image.end()) ==
+              std::vector<Edge>(g.begin(), g.end()));
+      REQUIRE_THROWS_AS(image.IsConnected(1, 5), std::runtime_error);
+      REQUIRE_THROWS_AS(image.GetConnected(5), std::out_of_range);
+      REQUIRE_THROWS_AS(image.GetWeights(5, 1), std::out_of_range);
+    }
+
+    THEN("another process attaches to the same image") {
+      pid_t child = fork();
+      if (child == 0) {
+        auto attached = gdwg::SharedImage<int, double>::Attach(name);
+        _exit(attached.GetWeights(3, 1) == std::vector<double>{2} ? 0 : 1);
+      }
+      int status = -1;
+      waitpid(child, &status, 0);
+      REQUIRE(WIFEXITED(status));
+      REQUIRE(WEXITSTATUS(status) == 0);
+    }
+
+    WHEN("a new version is published") {
+      g.DeleteNode(1);
+      gdwg::SharedImage<int, double>::Publish(g, name);
+
+      THEN("readers keep the old version until they refresh") {
+        REQUIRE(image.IsConnected(1, 2));
+        REQUIRE(image.Refresh());
+        REQUIRE(image.Version() == 2);
+        REQUIRE_FALSE(image.IsNode(1));
+        REQUIRE(std::vector<Edge>(image.begin(), image.end()) == std::vector<Edge>{{4, 4, 1}});
+        REQUIRE_FALSE(image.Refresh());
+      }
+    }
+
+    WHEN("the graph is unpublished") {
+      gdwg::SharedImage<int, double>::Unpublish(name);
+
+      THEN("the mapped image stays readable but no reader can attach") {
+        REQUIRE_FALSE(image.Refresh());
+        REQUIRE(image.IsConnected(4, 4));
+        REQUIRE_THROWS_AS((gdwg::SharedImage<int, double>::Attach(name)), std::runtime_error);
+      }
+    }
+
+    gdwg::SharedImage<int, double>::Unpublish(name);
+  }
+
+  GIVEN("an empty graph") {
+    const std::string name = "/gdwg_test_empty_" + std::to_string(getpid());
+    gdwg::SharedImage<int, double>::Publish(gdwg::Graph<int, double>{}, name);
+    auto image = gdwg::SharedImage<int, double>::Attach(name);
+
+    THEN("the image is empty") {
+      REQUIRE(image.GetNodes().empty());
+      REQUIRE(image.begin() == image.end());
+    }
+
+    gdwg::SharedImage<int, double>::Unpublish(name);
+  }
+
+  GIVEN("a published image whose segment is damaged") {
+    const std::string name = "/gdwg_test_damaged_" + std::to_string(getpid());
+    gdwg::Graph<int, double> g{1, 2, 3};
+    g.InsertEdge(1, 2, 0.5);
+    g.InsertEdge(2, 3, 1);
+    gdwg::SharedImage<int, double>::Publish(g, name);
+    auto image = gdwg::SharedImage<int, double>::Attach(name);
+    gdwg::SharedImage<int, double>::Publish(g, name);
+
+    const std::string segment = name + ".2";
+    int fd = shm_open(segment.c_str(), O_RDWR, 0);
+    REQUIRE(fd >= 0);
+    struct stat st {};
+    REQUIRE(fstat(fd, &st) == 0);
+
+    WHEN("it is truncated") {
+      REQUIRE(ftruncate(fd, st.st_size - 8) == 0);
+
+      THEN("attaching and refreshing throw rather than read past it") {
+        REQUIRE_THROWS_AS((gdwg::SharedImage<int, double>::Attach(name)), std::runtime_error);
+        REQUIRE_THROWS_AS(image.Refresh(), std::runtime_error);
+        REQUIRE(image.Version() == 1);
+        REQUIRE(image.IsConnected(2, 3));
+      }
+    }
+
+    WHEN("it doesn't start with the image magic") {
+      void* base = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+      REQUIRE(base != MAP_FAILED);
+      static_cast<char*>(base)[0] ^= 1;
+      munmap(base, static_cast<std::size_t>(st.st_size));
+
+      THEN("attaching and refreshing throw") {
+        REQUIRE_THROWS_AS((gdwg::SharedImage<int, double>::Attach(name)), std::runtime_error);
+        REQUIRE_THROWS_AS(image.Refresh(), std::runtime_error);
+      }
+    }
+
+    close(fd);
+    gdwg::SharedImage<int, double>::Unpublish(name);
+  }
+
+  GIVEN("a control segment too small to hold a version") {
+    const std::string name = "/gdwg_test_control_" + std::to_string(getpid());
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    REQUIRE(fd >= 0);
+    REQUIRE(ftruncate(fd, 4) == 0);
+    close(fd);
+
+    THEN("attaching throws") {
+      REQUIRE_THROWS_AS((gdwg::SharedImage<int, double>::Attach(name)), std::runtime_error);
+    }
+
+    shm_unlink(name.c_str());
+  }
+}